@@ -0,0 +1,247 @@
+// gentree.cpp
+//
+// ----------------------------------------------------------------------------
+//
+// Copyright (C) 2021  Jean-Marc Bourguet
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//   * Redistributions of source code must retain the above copyright
+//     notice, this list of conditions and the following disclaimer.
+//
+//   * Redistributions in binary form must reproduce the above copyright
+//     notice, this list of conditions and the following disclaimer in the
+//     documentation and/or other materials provided with the distribution.
+//
+//   * Neither the name of Jean-Marc Bourguet nor the names of other
+//     contributors may be used to endorse or promote products derived from
+//     this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+// IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+// TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+// PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+// TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+// NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// ----------------------------------------------------------------------------
+//
+// Generate a synthetic directory tree for the benchmarks:
+//
+//     gentree shape entries dir
+//
+// where shape is one of
+//   deep       chains of nested directories, each with a few files
+//   wide       a single directory holding all the files
+//   tiny       a balanced tree of small files
+//   hardlinks  a balanced tree where most files are hard links
+//   mixed      an irregular tree with sizes spread over several magnitudes
+//
+// The result depends only on the arguments, so that runs are comparable.
+// Everything is created relatively to directory descriptors, so that deep
+// trees are not limited by PATH_MAX.
+//
+// ----------------------------------------------------------------------------
+
+#include <errno.h>
+#include <fcntl.h>
+#include <iostream>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+namespace
+{
+
+size_t const maxChainDepth = 1000;
+
+/// A deterministic pseudo random generator (xorshift64*)
+class Random
+{
+public:
+    explicit Random(uint64_t seed) : myState(seed ? seed : 1) {}
+    uint64_t next()
+    {
+        myState ^= myState >> 12;
+        myState ^= myState << 25;
+        myState ^= myState >> 27;
+        return myState * 0x2545F4914F6CDD1DULL;
+    }
+    /// in [0, n)
+    size_t below(size_t n) { return n == 0 ? 0 : next() % n; }
+private:
+    uint64_t myState;
+}; // Random
+
+std::vector<char> theZeros(1 << 20);
+size_t theEntries = 0;
+std::vector<std::string> theLinkTargets; // relative to the root
+
+void fail(std::string const& what)
+{
+    std::cerr << "gentree: " << what << ": " << strerror(errno) << '\n';
+    exit(EXIT_FAILURE);
+}
+
+std::string nameOf(char prefix, size_t i)
+{
+    return prefix + std::to_string(i);
+}
+
+int makeDirectory(int parent, std::string const& name)
+{
+    if (mkdirat(parent, name.c_str(), 0755) != 0 && errno != EEXIST)
+        fail("mkdir " + name);
+    int fd = openat(parent, name.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0)
+        fail("open " + name);
+    ++theEntries;
+    return fd;
+}
+
+void makeFile(int dir, std::string const& name, size_t size)
+{
+    int fd = openat(dir, name.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0)
+        fail("create " + name);
+    while (size > 0) {
+        size_t const chunk = size < theZeros.size() ? size : theZeros.size();
+        ssize_t const written = write(fd, &theZeros[0], chunk);
+        if (written <= 0)
+            fail("write " + name);
+        size -= size_t(written);
+    }
+    close(fd);
+    ++theEntries;
+}
+
+/// a size between 0 and 2^maxBits, roughly uniform in magnitude
+size_t spreadSize(Random& random, unsigned maxBits)
+{
+    unsigned const bits = unsigned(random.below(maxBits + 1));
+    return bits == 0 ? 0 : size_t(1) << (bits - 1) | random.below(size_t(1) << (bits - 1));
+}
+
+void deep(int root, size_t entries)
+{
+    size_t const perLevel = 3; // a directory and two files
+    size_t const chains = (entries / perLevel + maxChainDepth - 1) / maxChainDepth;
+    for (size_t c = 0; c < chains && theEntries < entries; ++c) {
+        int dir = makeDirectory(root, nameOf('c', c));
+        for (size_t level = 0; level < maxChainDepth && theEntries < entries; ++level) {
+            makeFile(dir, "f0", 1000);
+            makeFile(dir, "f1", 5000);
+            int sub = makeDirectory(dir, "d");
+            close(dir);
+            dir = sub;
+        }
+        close(dir);
+    }
+}
+
+void wide(int root, size_t entries)
+{
+    for (size_t i = 0; theEntries < entries; ++i) {
+        makeFile(root, nameOf('f', i), i % 4096);
+    }
+}
+
+/// A balanced tree: fanOut subdirectories and filesPerDir files per
+/// directory, created breadth first until entries are created.
+void balanced(int root, size_t entries, size_t fanOut, size_t filesPerDir,
+              bool links, Random& random)
+{
+    std::vector<std::string> queue(1, ".");
+    for (size_t next = 0; next < queue.size() && theEntries < entries; ++next) {
+        int dir = next == 0 ? dup(root) : openat(root, queue[next].c_str(),
+                                                 O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        if (dir < 0)
+            fail("open " + queue[next]);
+        for (size_t f = 0; f < filesPerDir && theEntries < entries; ++f) {
+            std::string const name = nameOf('f', f);
+            std::string const path = queue[next] + '/' + name;
+            if (links && !theLinkTargets.empty() && random.below(10) != 0) {
+                std::string const& target = theLinkTargets[random.below(theLinkTargets.size())];
+                if (linkat(root, target.c_str(), root, path.c_str(), 0) != 0 && errno != EEXIST)
+                    fail("link " + path);
+                ++theEntries;
+            } else {
+                makeFile(dir, name, links ? 4096 + random.below(16384) : random.below(100));
+                if (links)
+                    theLinkTargets.push_back(path);
+            }
+        }
+        for (size_t d = 0; d < fanOut && theEntries < entries; ++d) {
+            std::string const name = nameOf('d', d);
+            close(makeDirectory(dir, name));
+            queue.push_back(queue[next] + '/' + name);
+        }
+        close(dir);
+    }
+}
+
+void mixed(int dir, size_t entries, size_t depth, Random& random)
+{
+    size_t const files = random.below(40);
+    for (size_t f = 0; f < files && theEntries < entries; ++f) {
+        makeFile(dir, nameOf('f', f), spreadSize(random, 16));
+    }
+    if (depth == 12)
+        return;
+    size_t const subDirs = depth == 0 ? 20 : random.below(8);
+    for (size_t d = 0; d < subDirs && theEntries < entries; ++d) {
+        int sub = makeDirectory(dir, nameOf('d', d));
+        mixed(sub, entries, depth + 1, random);
+        close(sub);
+    }
+}
+
+}
+
+// ----------------------------------------------------------------------------
+
+int main(int argc, char* argv[])
+{
+    if (argc != 4) {
+        std::cerr << "Usage: gentree deep|wide|tiny|hardlinks|mixed entries dir\n";
+        return EXIT_FAILURE;
+    }
+    std::string const shape(argv[1]);
+    size_t const entries = strtoull(argv[2], NULL, 0);
+    int root = makeDirectory(AT_FDCWD, argv[3]);
+    theEntries = 0;
+    Random random(entries);
+    if (shape == "deep") {
+        deep(root, entries);
+    } else if (shape == "wide") {
+        wide(root, entries);
+    } else if (shape == "tiny") {
+        balanced(root, entries, 16, 32, false, random);
+    } else if (shape == "hardlinks") {
+        balanced(root, entries, 8, 32, true, random);
+    } else if (shape == "mixed") {
+        // several passes if the random tree is too small
+        for (size_t pass = 0; theEntries < entries; ++pass) {
+            int dir = makeDirectory(root, nameOf('p', pass));
+            mixed(dir, entries, 0, random);
+            close(dir);
+        }
+    } else {
+        std::cerr << "gentree: unknown shape " << shape << '\n';
+        return EXIT_FAILURE;
+    }
+    close(root);
+    return EXIT_SUCCESS;
+} // main
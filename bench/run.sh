@@ -0,0 +1,97 @@
+#!/bin/sh
+# Copyright (c) 2021  Jean-Marc Bourguet
+#
+# All rights reserved.
+#
+# Redistribution and use in source and binary forms, with or without
+# modification, are permitted provided that the following conditions are met:
+#
+# * Redistributions of source code must retain the above copyright
+# notice, this list of conditions and the following disclaimer.
+#
+# * Redistributions in binary form must reproduce the above copyright
+# notice, this list of conditions and the following disclaimer in the
+# documentation and/or other materials provided with the distribution.
+#
+# * Neither the name of Jean-Marc Bourguet nor the names of the other
+# contributors may be used to endorse or promote products derived from
+# this software without specific prior written permission.
+#
+# THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+# AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+# IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+# ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+# LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+# CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+# SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+# INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+# CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+# ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+# POSSIBILITY OF SUCH DAMAGE.
+
+# Time dirsize on synthetic trees:
+#
+#     run.sh dirsize gentree results [version]
+#
+# For each shape and size, the tree is generated once (in $BENCH_DIR, by
+# default /dev/shm if it exists), scanned once to warm the caches, then
+# $BENCH_RUNS times with --stats both for the tree view and the flat one.
+# The phases are appended to results as tab separated lines:
+#
+#     version shape entries run phase wall_s cpu_s
+#
+# where phase is scan, collect, showtree or flat.  The trees are kept for
+# the next runs; remove $BENCH_DIR/dirsize-bench to regenerate them.
+
+set -e
+
+if [ $# -lt 3 ]; then
+    echo "Usage: run.sh dirsize gentree results [version]" >&2
+    exit 1
+fi
+dirsize=$1
+gentree=$2
+results=$3
+version=${4:-unknown}
+
+if [ -z "$BENCH_DIR" ]; then
+    if [ -d /dev/shm ]; then BENCH_DIR=/dev/shm; else BENCH_DIR=${TMPDIR:-/tmp}; fi
+fi
+sizes=${BENCH_SIZES:-"10000 100000"}
+shapes=${BENCH_SHAPES:-"deep wide tiny hardlinks mixed"}
+runs=${BENCH_RUNS:-3}
+work=$BENCH_DIR/dirsize-bench
+mkdir -p "$work"
+
+# phase json name: the wall and cpu times of phase name in json
+phase() {
+    echo "$1" | sed -n "s/.*\"$2\": {\"wall_s\": \([^,]*\), \"cpu_s\": \([^}]*\)}.*/\1	\2/p"
+}
+
+[ -s "$results" ] || printf 'version\tshape\tentries\trun\tphase\twall_s\tcpu_s\n' > "$results"
+
+for shape in $shapes; do
+    for size in $sizes; do
+        tree=$work/$shape-$size
+        if [ ! -e "$tree.done" ]; then
+            echo "Generating $tree" >&2
+            rm -rf "$tree"
+            "$gentree" "$shape" "$size" "$tree"
+            touch "$tree.done"
+        fi
+        "$dirsize" -s "$tree" > /dev/null
+        run=1
+        while [ $run -le $runs ]; do
+            hier=$("$dirsize" -s --stats -t "$tree" 2>&1 > /dev/null)
+            flat=$("$dirsize" -s --stats "$tree" 2>&1 > /dev/null)
+            prefix="$version	$shape	$size	$run"
+            {
+                echo "$prefix	scan	$(phase "$hier" scan)"
+                echo "$prefix	collect	$(phase "$flat" collect)"
+                echo "$prefix	showtree	$(phase "$hier" output)"
+                echo "$prefix	flat	$(phase "$flat" output)"
+            } | tee -a "$results"
+            run=$((run + 1))
+        done
+    done
+done
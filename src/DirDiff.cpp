@@ -0,0 +1,329 @@
+// DirDiff.cpp
+//
+// ----------------------------------------------------------------------------
+//
+// Copyright (C) 2021  Jean-Marc Bourguet
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//   * Redistributions of source code must retain the above copyright
+//     notice, this list of conditions and the following disclaimer.
+//
+//   * Redistributions in binary form must reproduce the above copyright
+//     notice, this list of conditions and the following disclaimer in the
+//     documentation and/or other materials provided with the distribution.
+//
+//   * Neither the name of Jean-Marc Bourguet nor the names of other
+//     contributors may be used to endorse or promote products derived from
+//     this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+// IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+// TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+// PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+// TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+// NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// ----------------------------------------------------------------------------
+
+#include "DirDiff.hpp"
+
+#include <algorithm>
+#include <string.h>
+
+#include "info.hpp"
+
+namespace
+{
+
+size_t magnitude(long long delta)
+{
+    return delta < 0 ? size_t(-delta) : size_t(delta);
+}
+
+}
+
+// ----------------------------------------------------------------------------
+
+/// Order the nodes of the result by decreasing absolute delta
+class DirDiff::IsBigger
+{
+public:
+    explicit IsBigger(DirDiff const* diff) : myDiff(diff) {}
+    bool operator()(Index l, Index r) const
+    {
+        return magnitude(myDiff->delta(l)) > magnitude(myDiff->delta(r));
+    }
+private:
+    DirDiff const* myDiff;
+}; // IsBigger
+
+// ----------------------------------------------------------------------------
+
+/// Order the nodes of a tree by name, the content node (without name) first
+class DirDiff::NameIsSmaller
+{
+public:
+    explicit NameIsSmaller(DirTree const* tree) : myTree(tree) {}
+    bool operator()(DirTree::Index l, DirTree::Index r) const
+    {
+        return strcmp(myTree->name(l), myTree->name(r)) < 0;
+    }
+private:
+    DirTree const* myTree;
+}; // NameIsSmaller
+
+// ----------------------------------------------------------------------------
+
+DirDiff::DirDiff(DirTree const& oldTree, DirTree const& newTree)
+    : myOld(&oldTree),
+      myNew(&newTree)
+{
+} // DirDiff
+
+// ----------------------------------------------------------------------------
+
+DirDiff::Index DirDiff::compare(DirTree::Index oldRoot, DirTree::Index newRoot)
+{
+    return compare(oldRoot, newRoot, none, none);
+} // compare
+
+// ----------------------------------------------------------------------------
+
+DirDiff::Index DirDiff::compare(DirTree::Index oldNode, DirTree::Index newNode,
+                                Index parent, Index previous)
+{
+    Index const result = Index(myNodes.size());
+    Node node;
+    node.oldIndex = oldNode;
+    node.newIndex = newNode;
+    node.delta = 0;
+    if (newNode != DirTree::none)
+        node.delta += static_cast<long long>(displaySize(myNew->size(newNode), myNew->isLogical()));
+    if (oldNode != DirTree::none)
+        node.delta -= static_cast<long long>(displaySize(myOld->size(oldNode), myOld->isLogical()));
+    node.parent = parent;
+    node.firstChild = none;
+    node.nextSibling = none;
+    myNodes.push_back(node);
+    if (previous != none) {
+        myNodes[previous].nextSibling = result;
+    } else if (parent != none) {
+        myNodes[parent].firstChild = result;
+    }
+
+    std::vector<DirTree::Index> oldChildren;
+    std::vector<DirTree::Index> newChildren;
+    if (oldNode != DirTree::none)
+        children(*myOld, oldNode, oldChildren);
+    if (newNode != DirTree::none)
+        children(*myNew, newNode, newChildren);
+    size_t o = 0;
+    size_t n = 0;
+    Index last = none;
+    while (o < oldChildren.size() || n < newChildren.size()) {
+        int cmp;
+        if (o == oldChildren.size()) {
+            cmp = 1;
+        } else if (n == newChildren.size()) {
+            cmp = -1;
+        } else {
+            cmp = strcmp(myOld->name(oldChildren[o]), myNew->name(newChildren[n]));
+        }
+        if (cmp < 0) {
+            last = compare(oldChildren[o++], DirTree::none, result, last);
+        } else if (cmp > 0) {
+            last = compare(DirTree::none, newChildren[n++], result, last);
+        } else {
+            last = compare(oldChildren[o++], newChildren[n++], result, last);
+        }
+    }
+    return result;
+} // compare
+
+// ----------------------------------------------------------------------------
+
+void DirDiff::children(DirTree const& tree, DirTree::Index node,
+                       std::vector<DirTree::Index>& result) const
+{
+    for (DirTree::Index i = tree.firstChild(node); i != DirTree::none;
+         i = tree.nextSibling(i))
+    {
+        result.push_back(i);
+    }
+    std::sort(result.begin(), result.end(), NameIsSmaller(&tree));
+} // children
+
+// ----------------------------------------------------------------------------
+
+long long DirDiff::delta(Index i) const
+{
+    return myNodes[i].delta;
+} // delta
+
+// ----------------------------------------------------------------------------
+
+std::string DirDiff::name(Index i) const
+{
+    std::string result;
+    appendName(result, i);
+    return result;
+} // name
+
+// ----------------------------------------------------------------------------
+
+void DirDiff::appendName(std::string& out, Index i) const
+{
+    Node const& node = myNodes[i];
+    out += plainName(i);
+    if (node.oldIndex == DirTree::none)
+        out += " (new)";
+    else if (node.newIndex == DirTree::none)
+        out += " (removed)";
+} // appendName
+
+// ----------------------------------------------------------------------------
+
+char const* DirDiff::plainName(Index i) const
+{
+    Node const& node = myNodes[i];
+    DirTree const* tree = node.newIndex != DirTree::none ? myNew : myOld;
+    DirTree::Index const index = node.newIndex != DirTree::none ? node.newIndex : node.oldIndex;
+    return tree->isContent(index) ? "(directory content)" : tree->name(index);
+} // plainName
+
+// ----------------------------------------------------------------------------
+
+std::string DirDiff::path(Index i) const
+{
+    std::string result;
+    appendPath(result, i);
+    return result;
+} // path
+
+// ----------------------------------------------------------------------------
+
+void DirDiff::appendPath(std::string& out, Index i) const
+{
+    appendPlainPath(out, myNodes[i].parent);
+    appendName(out, i);
+} // appendPath
+
+// ----------------------------------------------------------------------------
+
+void DirDiff::appendPlainPath(std::string& out, Index i) const
+{
+    if (i == none)
+        return;
+    appendPlainPath(out, myNodes[i].parent);
+    out += plainName(i);
+    out += '/';
+} // appendPlainPath
+
+// ----------------------------------------------------------------------------
+
+DirDiff::Index DirDiff::parent(Index i) const
+{
+    return myNodes[i].parent;
+} // parent
+
+// ----------------------------------------------------------------------------
+
+DirDiff::Index DirDiff::firstChild(Index i) const
+{
+    return myNodes[i].firstChild;
+} // firstChild
+
+// ----------------------------------------------------------------------------
+
+DirDiff::Index DirDiff::nextSibling(Index i) const
+{
+    return myNodes[i].nextSibling;
+} // nextSibling
+
+// ----------------------------------------------------------------------------
+
+void DirDiff::collect(Index i, size_t minDelta, std::vector<Index>& nodes,
+                      size_t minDepth) const
+{
+    for (Index c = firstChild(i); c != none; c = nextSibling(c)) {
+        if (magnitude(delta(c)) >= minDelta || minDepth > 0) {
+            nodes.push_back(c);
+            collect(c, minDelta, nodes, minDepth > 0 ? minDepth-1 : 0);
+        }
+    }
+} // collect
+
+// ----------------------------------------------------------------------------
+
+void DirDiff::showTree(std::ostream& os, Index i, size_t minDelta, size_t minDepth) const
+{
+    // the walk of DirInfo::showTree: the selected children of the nodes on
+    // the current path in one vector, the marks of the ancestors in prefix
+    // and the lines not yet written in out
+    struct Frame
+    {
+        size_t begin; // in selected
+        size_t next;
+        size_t level;
+    };
+    std::vector<Frame> frames;
+    std::vector<Index> selected;
+    std::string prefix;
+    std::string out;
+    size_t const flushSize = 1 << 20;
+    out.reserve(flushSize + 4096);
+
+    Index current = i;
+    size_t level = 0;
+    bool hasOtherDirs = false;
+    for (;;) {
+        prefix.resize(level > 0 ? 2*(level-1) : 0);
+        size_t const start = out.size();
+        appendDelta(out, delta(current));
+        alignRight(out, start, 15);
+        out += ' ';
+        out += prefix;
+        if (level > 0)
+            out += "+ ";
+        appendName(out, current);
+        out += '\n';
+        if (out.size() >= flushSize) {
+            os.write(out.data(), std::streamsize(out.size()));
+            out.clear();
+        }
+        if (level > 0)
+            prefix += hasOtherDirs ? "| " : "  ";
+
+        size_t const begin = selected.size();
+        for (Index c = firstChild(current); c != none; c = nextSibling(c)) {
+            if (minDepth > level || magnitude(delta(c)) >= minDelta)
+                selected.push_back(c);
+        }
+        if (selected.size() != begin) {
+            std::sort(selected.begin() + std::ptrdiff_t(begin), selected.end(),
+                      IsBigger(this));
+            Frame const frame = { begin, begin, level + 1 };
+            frames.push_back(frame);
+        }
+
+        while (!frames.empty() && frames.back().next == selected.size()) {
+            selected.resize(frames.back().begin);
+            frames.pop_back();
+        }
+        if (frames.empty())
+            break;
+        current = selected[frames.back().next++];
+        level = frames.back().level;
+        hasOtherDirs = frames.back().next != selected.size();
+    }
+    os.write(out.data(), std::streamsize(out.size()));
+} // showTree
@@ -0,0 +1,121 @@
+// DirDiff.hpp
+//
+// ----------------------------------------------------------------------------
+//
+// Copyright (C) 2021  Jean-Marc Bourguet
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//   * Redistributions of source code must retain the above copyright
+//     notice, this list of conditions and the following disclaimer.
+//
+//   * Redistributions in binary form must reproduce the above copyright
+//     notice, this list of conditions and the following disclaimer in the
+//     documentation and/or other materials provided with the distribution.
+//
+//   * Neither the name of Jean-Marc Bourguet nor the names of other
+//     contributors may be used to endorse or promote products derived from
+//     this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+// IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+// TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+// PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+// TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+// NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+// ----------------------------------------------------------------------------
+//
+// Comparison of two DirTree: the size change of each directory present in
+// either of them.  Both trees are walked together, the children of two
+// matching nodes being sorted by name and then merged, so that the cost is
+// linear in the size of the trees (besides the sorts) and no path is built.
+//
+// ----------------------------------------------------------------------------
+
+#ifndef DIR_DIFF_HPP
+#define DIR_DIFF_HPP
+
+#include <ostream>
+#include <stddef.h>
+#include <string>
+#include <vector>
+
+#include "DirTree.hpp"
+
+// ----------------------------------------------------------------------------
+// DirDiff
+// ----------------------------------------------------------------------------
+
+class DirDiff
+{
+public:
+    typedef uint32_t Index;
+    static Index const none = 0xFFFFFFFFU;
+
+    DirDiff(DirTree const& oldTree, DirTree const& newTree);
+
+    /// Compare the subtrees rooted at oldRoot and newRoot (one of them may
+    /// be none); returns the root of the result.
+    Index compare(DirTree::Index oldRoot, DirTree::Index newRoot);
+
+    /// size in the new tree minus size in the old one, as displayed
+    long long delta(Index i) const;
+    /// the name, flagged if the node is only in one tree
+    std::string name(Index i) const;
+    void appendName(std::string& out, Index i) const;
+    /// the path, the last component flagged as name is
+    std::string path(Index i) const;
+    void appendPath(std::string& out, Index i) const;
+    Index parent(Index i) const;
+    Index firstChild(Index i) const;
+    Index nextSibling(Index i) const;
+
+    /// like DirInfo::collect, using the absolute value of the delta
+    void collect(Index i, size_t minDelta, std::vector<Index>& nodes,
+                 size_t minDepth) const;
+    /// like DirInfo::showTree, using the absolute value of the delta
+    void showTree(std::ostream& os, Index i, size_t minDelta, size_t minDepth) const;
+private: // and not implemented
+    DirDiff(DirDiff const&);
+    DirDiff& operator=(DirDiff const&);
+
+private:
+    struct Node
+    {
+        DirTree::Index oldIndex;
+        DirTree::Index newIndex;
+        long long delta;
+        Index parent;
+        Index firstChild;
+        Index nextSibling;
+    };
+
+    class IsBigger;
+    class NameIsSmaller;
+
+    Index compare(DirTree::Index oldNode, DirTree::Index newNode,
+                  Index parent, Index previous);
+    char const* plainName(Index i) const;
+    /// append the path of i, unflagged and followed by a /, to out
+    void appendPlainPath(std::string& out, Index i) const;
+    void children(DirTree const& tree, DirTree::Index node,
+                  std::vector<DirTree::Index>& result) const;
+
+    DirTree const* myOld;
+    DirTree const* myNew;
+    std::vector<Node> myNodes;
+}; // DirDiff
+
+// ----------------------------------------------------------------------------
+
+#endif
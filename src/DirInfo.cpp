@@ -37,262 +37,457 @@
 #include "DirInfo.hpp"
 
 #include <algorithm>
-#include <dirent.h>
-#include <errno.h>
-#include <fnmatch.h>
-#include <iomanip>
-#include <sstream>
-#include <sys/stat.h>
-#include <sys/types.h>
-#include <unistd.h>
+#include <stdint.h>
+#include <stdio.h>
 
 #include "info.hpp"
 
 namespace
 {
 
-struct IsSmallerThan
+bool isBigger(DirInfo const& l, DirInfo const& r)
 {
-    IsSmallerThan(size_t limit) : myLimit(limit) {}
-    bool operator()(DirInfo* dir)
-    {
-        return dir->size() < myLimit;
+    return l.size() > r.size();
+}
+
+/// Append the class of kind with the biggest size, with its share
+void appendBiggest(std::string& out, Histogram const* histogram, Histogram::Kind kind)
+{
+    uint64_t total = 0;
+    if (histogram != NULL) {
+        for (size_t c = 0; c < Histogram::classCount(kind); ++c) {
+            total += histogram->size(kind, c);
+        }
+    }
+    if (total == 0) {
+        out += '-';
+        return;
     }
-private:
-    size_t myLimit;
-};
+    size_t const biggest = histogram->biggest(kind);
+    out += Histogram::className(kind, biggest);
+    out += ' ';
+    out += std::to_string(histogram->size(kind, biggest) * 100 / total);
+    out += '%';
+}
 
-bool isBigger(DirInfo* l, DirInfo* r)
+/// Append the path of i, made of the names of the tree, followed by a '/'
+void appendDirectory(std::string& out, DirTree const& tree, DirTree::Index i)
 {
-    return l->size() > r->size();
+    DirTree::Index const parent = tree.parent(i);
+    if (parent != DirTree::none)
+        appendDirectory(out, tree, parent);
+    out += tree.name(i);
+    out += '/';
 }
 
 }
 
 // ----------------------------------------------------------------------------
 
-std::set<std::string> DirInfo::ourIgnoredDirectories;
+std::vector<DirInfo::Column> DirInfo::ourColumns(1, DirInfo::sizeColumn);
 
 // ----------------------------------------------------------------------------
 
-DirInfo::DirInfo(size_t size, size_t max, std::string const& name, DirInfo* parent)
-    : myName("(directory)"),
-      myParent(parent),
-      mySize(size),
-      myDirectSize(size)
+DirInfo::DirInfo()
+    : myTree(NULL),
+      myIndex(DirTree::none)
 {
-    if (!name.empty()) {
-        std::ostringstream os;
-        os << "(directory content, max: " << displaySize(max)
-           << " for " << name << ")";
-        myName = os.str();
-    }
 } // DirInfo
 
 // ----------------------------------------------------------------------------
 
-DirInfo::DirInfo(std::string const& pName, std::string const& pPath, DirInfo* parent)
-    : myName(pName),
-      myParent(parent),
-      mySize(0),
-      myDirectSize(0)
+DirInfo::DirInfo(DirTree const* tree, DirTree::Index index)
+    : myTree(tree),
+      myIndex(index)
 {
-    size_t maxDirectEntry = 0;
-    std::string maxDirectEntryName;
+} // DirInfo
 
-    message("Reading " + pPath);
-    {
-        struct stat info;
-        if (lstat(pPath.c_str(), &info) != 0) {
-            error("Error while getting information about " + pPath);
-        } else {
-            myDirectSize += getSize(info);
-            maxDirectEntry = myDirectSize;
-            maxDirectEntryName = "";
-        }
-    }
+// ----------------------------------------------------------------------------
 
-    DIR* dirIter = opendir(pPath.c_str());
-    if (dirIter == NULL) {
-        error("Unable to open " + pPath);
-    } else {
-        dirent* entry;
-        for (errno = 0, entry = readdir(dirIter);
-             entry != NULL;
-             errno = 0, entry = readdir(dirIter))
-        {
-            std::string const eName(entry->d_name);
-            if (eName != "." && eName != "..")
-            {
-                std::string const ePath(pPath + '/' + eName);
-                struct stat info;
-                if (lstat(ePath.c_str(), &info) != 0) {
-                    error("Error while getting information about " + ePath);
-                } else {
-                    if (S_ISDIR(info.st_mode) && !ignored(eName, ePath))
-                    {
-                        DirInfo* subInfo = new DirInfo(eName, ePath, this);
-                        message("Reading " + pPath);
-                        mySize += subInfo->mySize;
-                        mySubDirs.push_back(subInfo);
-                    } else {
-                        myDirectSize += getSize(info);
-                        if (maxDirectEntryName.empty() || getSize(info) > maxDirectEntry) {
-                            maxDirectEntry = getSize(info);
-                            maxDirectEntryName = eName;
-                        }
-                    }
-                }
-            }
-        }
-        if (errno != 0) {
-            error("Error while reading " + pPath);
-        }
-        closedir(dirIter);
-    }
-    if (mySize != 0) {
-        mySubDirs.push_back
-            (new DirInfo(myDirectSize, maxDirectEntry, maxDirectEntryName, this));
-    } else if (!maxDirectEntryName.empty()) {
-        std::ostringstream os;
-        os << myName << " (max: " << displaySize(maxDirectEntry)
-           << " for " << maxDirectEntryName << ")";
-        myName = os.str();
-    }
-    mySize += myDirectSize;
-} // DirInfo
+bool DirInfo::isNull() const
+{
+    return myIndex == DirTree::none;
+} // isNull
 
 // ----------------------------------------------------------------------------
 
-DirInfo* DirInfo::parent() const
+DirTree::Index DirInfo::index() const
 {
-    return myParent;
+    return myIndex;
+} // index
+
+// ----------------------------------------------------------------------------
+
+DirInfo DirInfo::parent() const
+{
+    return DirInfo(myTree, myTree->parent(myIndex));
 } // parent
 
 // ----------------------------------------------------------------------------
 
 std::string DirInfo::name() const
 {
-    return myName;
+    std::string result;
+    appendName(result);
+    return result;
 } // name
 
 // ----------------------------------------------------------------------------
 
+void DirInfo::appendName(std::string& out) const
+{
+    char const* maxName = myTree->maxEntryName(myIndex);
+    if (myTree->isContent(myIndex)) {
+        if (maxName == NULL) {
+            out += "(directory)";
+            return;
+        }
+        out += "(directory content, max: ";
+        appendNumber(out, displaySize(myTree->maxEntrySize(myIndex), myTree->isLogical()));
+        out += " for ";
+        out += maxName;
+        out += ')';
+        return;
+    }
+    out += myTree->name(myIndex);
+    if (myTree->isMountPoint(myIndex)) {
+        out += " (mount point, not crossed)";
+        return;
+    }
+    if (myTree->isOtherRoot(myIndex)) {
+        DirTree::Index root = myTree->firstRoot();
+        while (root != DirTree::none
+               && (root == myIndex || myTree->isOtherRoot(root)
+                   || myTree->device(root) != myTree->device(myIndex)
+                   || myTree->inode(root) != myTree->inode(myIndex)))
+        {
+            root = myTree->nextSibling(root);
+        }
+        out += " (scanned as ";
+        out += root != DirTree::none ? myTree->name(root) : "another root";
+        out += ')';
+        return;
+    }
+    if (maxName != NULL) {
+        out += " (max: ";
+        appendNumber(out, displaySize(myTree->maxEntrySize(myIndex), myTree->isLogical()));
+        out += " for ";
+        out += maxName;
+        out += ')';
+    }
+} // appendName
+
+// ----------------------------------------------------------------------------
+
 std::string DirInfo::path() const
 {
-    return myParent != NULL ? myParent->path() + '/' + myName : myName;
+    std::string result;
+    appendPath(result);
+    return result;
 } // path
 
 // ----------------------------------------------------------------------------
 
+void DirInfo::appendPath(std::string& out) const
+{
+    // only the last component is decorated
+    DirTree::Index const parent = myTree->parent(myIndex);
+    if (parent != DirTree::none)
+        appendDirectory(out, *myTree, parent);
+    appendName(out);
+} // appendPath
+
+// ----------------------------------------------------------------------------
+
 size_t DirInfo::size() const
 {
-    return displaySize(mySize);
+    return displaySize(myTree->size(myIndex), myTree->isLogical());
 } // size
 
 // ----------------------------------------------------------------------------
 
 size_t DirInfo::directSize() const
 {
-    return displaySize(myDirectSize);
+    return displaySize(myTree->directSize(myIndex), myTree->isLogical());
 } // directSize
 
 // ----------------------------------------------------------------------------
 
-std::deque<DirInfo*> const& DirInfo::subDirs() const
+size_t DirInfo::logicalSize() const
+{
+    if (myTree->isLogical())
+        return size();
+    return otherDisplaySize(myTree->otherSize(myIndex), false);
+} // logicalSize
+
+// ----------------------------------------------------------------------------
+
+size_t DirInfo::physicalSize() const
+{
+    if (!myTree->isLogical())
+        return size();
+    return otherDisplaySize(myTree->otherSize(myIndex), true);
+} // physicalSize
+
+// ----------------------------------------------------------------------------
+
+size_t DirInfo::files() const
+{
+    return myTree->files(myIndex);
+} // files
+
+// ----------------------------------------------------------------------------
+
+Histogram const* DirInfo::histogram() const
+{
+    return myTree->histogram(myIndex);
+} // histogram
+
+// ----------------------------------------------------------------------------
+
+bool DirInfo::isMountPoint() const
 {
-    return mySubDirs;
-} // subDirs
+    return myTree->isMountPoint(myIndex);
+} // isMountPoint
 
 // ----------------------------------------------------------------------------
 
-std::deque<DirInfo*>& DirInfo::subDirs()
+bool DirInfo::isOtherRoot() const
 {
-    return mySubDirs;
-} // subDirs
+    return myTree->isOtherRoot(myIndex);
+} // isOtherRoot
 
 // ----------------------------------------------------------------------------
 
-void DirInfo::collect(size_t minSize, std::deque<DirInfo*>& dirs, size_t minDepth) const
+DirInfo::SubDirIterator DirInfo::subDirsBegin() const
 {
-    for (std::deque<DirInfo*>::const_iterator i = mySubDirs.begin(), e = mySubDirs.end();
-         i != e; ++i)
+    return SubDirIterator(myTree, myTree->firstChild(myIndex));
+} // subDirsBegin
+
+// ----------------------------------------------------------------------------
+
+DirInfo::SubDirIterator DirInfo::subDirsEnd() const
+{
+    return SubDirIterator(myTree, DirTree::none);
+} // subDirsEnd
+
+// ----------------------------------------------------------------------------
+
+void DirInfo::collect(size_t minSize, std::vector<DirInfo>& dirs, size_t minDepth) const
+{
+    for (SubDirIterator i = subDirsBegin(), e = subDirsEnd(); i != e; ++i)
     {
-        if ((*i)->size() >= minSize || minDepth > 0) {
+        if (i->size() >= minSize || minDepth > 0) {
             dirs.push_back(*i);
-            (*i)->collect(minSize, dirs, minDepth-1);
+            i->collect(minSize, dirs, minDepth > 0 ? minDepth-1 : 0);
         }
     }
 } // collect
 
 // ----------------------------------------------------------------------------
 
-bool DirInfo::ignored(std::string const& name, std::string const& path)
+void DirInfo::collectBiggest(size_t minSize, size_t count, std::vector<DirInfo>& dirs,
+                             size_t minDepth) const
 {
-    if (ourIgnoredDirectories.find(name) != ourIgnoredDirectories.end()
-        || ourIgnoredDirectories.find(path) != ourIgnoredDirectories.end())
-    {
-        return true;
-    }
-    for (std::set<std::string>::iterator i = ourIgnoredDirectories.begin(),
-             e = ourIgnoredDirectories.end();
-         i != e; ++i)
+    for (SubDirIterator i = subDirsBegin(), e = subDirsEnd(); i != e; ++i)
     {
-        if (fnmatch((*i).c_str(), name.c_str(), FNM_PATHNAME) == 0
-            || fnmatch((*i).c_str(), path.c_str(), FNM_PATHNAME) == 0)
-        {
-            return true;
+        if (i->size() >= minSize || minDepth > 0) {
+            // the subdirectories are no bigger than their parent
+            if (dirs.size() == count && i->size() <= dirs.front().size())
+                continue;
+            keepBiggest(*i, count, dirs);
+            i->collectBiggest(minSize, count, dirs, minDepth > 0 ? minDepth-1 : 0);
         }
     }
-    return false;
-} // ignored
+} // collectBiggest
 
 // ----------------------------------------------------------------------------
 
-void DirInfo::showTree(std::ostream& os, size_t minSize, size_t minDepth) const
+void DirInfo::keepBiggest(DirInfo const& dir, size_t count, std::vector<DirInfo>& dirs)
 {
-    std::deque<bool> hasOtherDirs;
-    showTree(os, minSize, 0, minDepth, hasOtherDirs);
-}
+    if (dirs.size() < count) {
+        dirs.push_back(dir);
+        std::push_heap(dirs.begin(), dirs.end(), isBigger);
+    } else if (count > 0 && dir.size() > dirs.front().size()) {
+        std::pop_heap(dirs.begin(), dirs.end(), isBigger);
+        dirs.back() = dir;
+        std::push_heap(dirs.begin(), dirs.end(), isBigger);
+    }
+} // keepBiggest
 
 // ----------------------------------------------------------------------------
 
-void DirInfo::showTree
-     (std::ostream& os, size_t minSize, size_t level, size_t minDepth,
-      std::deque<bool> hasOtherDirs)
-    const
+void DirInfo::showTree(std::ostream& os, size_t minSize, size_t minDepth) const
 {
-    os << std::setw(15) << format(size()) << " ";
-    for (std::size_t i = 0; i+1 < level; ++i)
+    // Depth first walk without recursion: the selected subdirectories of the
+    // directories on the current path are kept sorted in one vector, the
+    // marks of the ancestors in prefix and the lines not yet written in out.
+    // Once they have grown, none of them is reallocated.
+    struct Frame
     {
-        os << (hasOtherDirs[i] ? "| " : "  ");
+        size_t begin; // in selected
+        size_t next;
+        size_t level;
+    };
+    std::vector<Frame> frames;
+    std::vector<DirInfo> selected;
+    std::string prefix;
+    std::string out;
+    size_t const flushSize = 1 << 20;
+    out.reserve(flushSize + 4096);
+
+    DirInfo current = *this;
+    size_t level = 0;
+    bool hasOtherDirs = false;
+    for (;;) {
+        prefix.resize(level > 0 ? 2*(level-1) : 0);
+        current.appendColumns(out);
+        out += ' ';
+        out += prefix;
+        if (level > 0)
+            out += "+ ";
+        current.appendName(out);
+        out += '\n';
+        if (out.size() >= flushSize) {
+            os.write(out.data(), std::streamsize(out.size()));
+            out.clear();
+        }
+        if (level > 0)
+            prefix += hasOtherDirs ? "| " : "  ";
+
+        size_t const begin = selected.size();
+        for (SubDirIterator i = current.subDirsBegin(), e = current.subDirsEnd(); i != e; ++i) {
+            // the pruned directories are shown as leaves, whatever their size
+            if (minDepth > level || i->size() >= minSize || i->isMountPoint()
+                || i->isOtherRoot())
+                selected.push_back(*i);
+        }
+        if (selected.size() != begin) {
+            std::sort(selected.begin() + std::ptrdiff_t(begin), selected.end(), isBigger);
+            Frame const frame = { begin, begin, level + 1 };
+            frames.push_back(frame);
+        }
+
+        while (!frames.empty() && frames.back().next == selected.size()) {
+            selected.resize(frames.back().begin);
+            frames.pop_back();
+        }
+        if (frames.empty())
+            break;
+        current = selected[frames.back().next++];
+        level = frames.back().level;
+        hasOtherDirs = frames.back().next != selected.size();
     }
-    if (level > 0)
-        os << "+ ";
-    os << name() << '\n';
-    std::deque<DirInfo*> selectedSubDir;
-    if (minDepth <= level) {
-        std::remove_copy_if(mySubDirs.begin(), mySubDirs.end(),
-                            std::back_inserter(selectedSubDir),
-                            IsSmallerThan(minSize));
-    } else {
-        std::copy(mySubDirs.begin(), mySubDirs.end(),
-                  std::back_inserter(selectedSubDir));
+    os.write(out.data(), std::streamsize(out.size()));
+} // showTree
+
+// ----------------------------------------------------------------------------
+
+void DirInfo::appendColumns(std::string& out) const
+{
+    for (size_t c = 0; c < ourColumns.size(); ++c) {
+        if (c > 0)
+            out += ' ';
+        size_t const start = out.size();
+        switch (ourColumns[c]) {
+        case sizeColumn:
+            appendFormat(out, size());
+            alignRight(out, start, 15);
+            break;
+        case logicalColumn:
+            appendFormat(out, logicalSize());
+            alignRight(out, start, 15);
+            break;
+        case physicalColumn:
+            appendFormat(out, physicalSize());
+            alignRight(out, start, 15);
+            break;
+        case ratioColumn:
+            // apparent over allocated: above 1 for sparse or compressed
+            // files, below for small ones
+            if (physicalSize() == 0) {
+                out += '-';
+            } else {
+                char ratio[32];
+                snprintf(ratio, sizeof ratio, "%.2f",
+                         double(logicalSize()) / double(physicalSize()));
+                out += ratio;
+            }
+            alignRight(out, start, 7);
+            break;
+        case filesColumn:
+            appendNumber(out, files());
+            alignRight(out, start, 12);
+            break;
+        case sizesColumn:
+            appendBiggest(out, histogram(), Histogram::bySize);
+            alignRight(out, start, 10);
+            break;
+        case typesColumn:
+            appendBiggest(out, histogram(), Histogram::byType);
+            alignRight(out, start, 13);
+            break;
+        case agesColumn:
+            appendBiggest(out, histogram(), Histogram::byAge);
+            alignRight(out, start, 10);
+            break;
+        }
     }
-    std::sort(selectedSubDir.begin(), selectedSubDir.end(), isBigger);
-    hasOtherDirs.push_back(selectedSubDir.begin() != selectedSubDir.end());
-    for (std::deque<DirInfo*>::iterator i = selectedSubDir.begin(),
-             e = selectedSubDir.end();
-         i != e; ++i)
-    {
-        hasOtherDirs.back() = (i+1) != e;
-        (*i)->showTree(os, minSize, level+1, minDepth, hasOtherDirs);
+} // appendColumns
+
+// ----------------------------------------------------------------------------
+
+bool DirInfo::needsHistograms()
+{
+    for (size_t c = 0; c < ourColumns.size(); ++c) {
+        if (ourColumns[c] == sizesColumn || ourColumns[c] == typesColumn
+            || ourColumns[c] == agesColumn)
+            return true;
     }
-}
+    return false;
+} // needsHistograms
+
+// ----------------------------------------------------------------------------
+
+void DirInfo::setColumns(std::vector<Column> const& columns)
+{
+    ourColumns = columns;
+} // setColumns
+
+// ----------------------------------------------------------------------------
+
+DirInfo::SubDirIterator::SubDirIterator(DirTree const* tree, DirTree::Index index)
+    : myCurrent(tree, index)
+{
+} // SubDirIterator
+
+// ----------------------------------------------------------------------------
+
+DirInfo::SubDirIterator& DirInfo::SubDirIterator::operator++()
+{
+    myCurrent = DirInfo(myCurrent.myTree, myCurrent.myTree->nextSibling(myCurrent.myIndex));
+    return *this;
+} // operator++
+
+// ----------------------------------------------------------------------------
+
+DirInfo::SubDirIterator DirInfo::SubDirIterator::operator++(int)
+{
+    SubDirIterator result(*this);
+    ++*this;
+    return result;
+} // operator++
+
+// ----------------------------------------------------------------------------
+
+bool DirInfo::SubDirIterator::operator==(SubDirIterator const& other) const
+{
+    return myCurrent.myIndex == other.myCurrent.myIndex;
+} // operator==
 
 // ----------------------------------------------------------------------------
 
-void DirInfo::addIgnoredDirectory(std::string const& name)
+bool DirInfo::SubDirIterator::operator!=(SubDirIterator const& other) const
 {
-    ourIgnoredDirectories.insert(name);
-} // addIgnoredDirectory
+    return !(*this == other);
+} // operator!=
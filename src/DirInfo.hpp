@@ -35,7 +35,7 @@
 //
 // ----------------------------------------------------------------------------
 //
-// Class containing collected directory information
+// Class giving access to the collected directory information
 //
 // ----------------------------------------------------------------------------
 
@@ -43,54 +43,95 @@
 #define DIR_INFO_HPP
 
 #include <string>
-#include <set>
-#include <deque>
+#include <iterator>
 #include <ostream>
+#include <vector>
+
+#include "DirTree.hpp"
 
 // ----------------------------------------------------------------------------
 // DirInfo
 // ----------------------------------------------------------------------------
 
+/// A view on a node of a DirTree
 class DirInfo
 {
 public:
-    DirInfo(std::string const& pName, std::string const& pPath, DirInfo* parent);
-    // ~DirInfo();
+    class SubDirIterator;
+    /// what the views show of each directory, before its name
+    enum Column { sizeColumn, logicalColumn, physicalColumn, ratioColumn, filesColumn,
+                  sizesColumn, typesColumn, agesColumn };
+
+    DirInfo();
+    DirInfo(DirTree const* tree, DirTree::Index index);
+
+    bool isNull() const;
+    DirTree::Index index() const;
 
     std::string name() const;
+    /// append name() to out
+    void appendName(std::string& out) const;
     std::string path() const;
-    DirInfo* parent() const;
+    /// append path() to out
+    void appendPath(std::string& out) const;
+    DirInfo parent() const;
     size_t size() const;
     size_t directSize() const;
-    std::deque<DirInfo*> const& subDirs() const;
-    std::deque<DirInfo*>& subDirs();
+    /// the logical and physical sizes, whichever size() is
+    size_t logicalSize() const;
+    size_t physicalSize() const;
+    /// number of files in the subtree
+    size_t files() const;
+    /// the distribution of the files of the subtree, NULL if not kept
+    Histogram const* histogram() const;
+    /// another file system is mounted on it, see ScanOptions::oneFileSystem
+    bool isMountPoint() const;
+    /// it is also a root, see Scanner::scan
+    bool isOtherRoot() const;
+    SubDirIterator subDirsBegin() const;
+    SubDirIterator subDirsEnd() const;
 
-    void collect(size_t minSize, std::deque<DirInfo*>& dirs, size_t minDepth) const;
+    void collect(size_t minSize, std::vector<DirInfo>& dirs, size_t minDepth) const;
+    /// Like collect, but keep in dirs only the count biggest directories, as
+    /// a heap with the smallest first.  The subtrees which can't make it,
+    /// being no bigger than the smallest kept, are not visited.
+    void collectBiggest(size_t minSize, size_t count, std::vector<DirInfo>& dirs,
+                        size_t minDepth) const;
+    /// add dir to the heap dirs, if it is one of the count biggest
+    static void keepBiggest(DirInfo const& dir, size_t count, std::vector<DirInfo>& dirs);
     void showTree(std::ostream& os, size_t minSize, size_t minDepth) const;
-    static void addIgnoredDirectory(std::string const& name);
-private: // and not implemented
-    DirInfo(DirInfo const&);
-    DirInfo& operator=(DirInfo const&);
-
+    /// append the columns, aligned, to out
+    void appendColumns(std::string& out) const;
+    /// whether a column needs the histograms
+    static bool needsHistograms();
+    static void setColumns(std::vector<Column> const& columns);
 private:
-    static std::set<std::string> ourIgnoredDirectories;
+    static std::vector<Column> ourColumns;
 
-    static bool ignored(std::string const& name, std::string const& path);
+    DirTree const* myTree;
+    DirTree::Index myIndex;
 
-    DirInfo(size_t size, size_t max, std::string const& name, DirInfo* parent);
+}; // DirInfo
 
-    std::string myName;
-    DirInfo* myParent;
-    size_t mySize;
-    size_t myDirectSize;
-    std::deque<DirInfo*> mySubDirs;
+// ----------------------------------------------------------------------------
+// DirInfo::SubDirIterator
+// ----------------------------------------------------------------------------
 
-    void showTree
-         (std::ostream& os, size_t minSize, size_t level, size_t minDepth,
-          std::deque<bool> hasOtherDirs)
-        const;
+class DirInfo::SubDirIterator
+    : public std::iterator<std::forward_iterator_tag, DirInfo const>
+{
+public:
+    SubDirIterator(DirTree const* tree, DirTree::Index index);
 
-}; // DirInfo
+    DirInfo const& operator*() const { return myCurrent; }
+    DirInfo const* operator->() const { return &myCurrent; }
+    SubDirIterator& operator++();
+    SubDirIterator operator++(int);
+    bool operator==(SubDirIterator const& other) const;
+    bool operator!=(SubDirIterator const& other) const;
+private:
+    DirInfo myCurrent;
+}; // SubDirIterator
 
 // ----------------------------------------------------------------------------
 
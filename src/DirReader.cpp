@@ -0,0 +1,198 @@
+// DirReader.cpp
+//
+// ----------------------------------------------------------------------------
+//
+// Copyright (C) 2021  Jean-Marc Bourguet
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//   * Redistributions of source code must retain the above copyright
+//     notice, this list of conditions and the following disclaimer.
+//
+//   * Redistributions in binary form must reproduce the above copyright
+//     notice, this list of conditions and the following disclaimer in the
+//     documentation and/or other materials provided with the distribution.
+//
+//   * Neither the name of Jean-Marc Bourguet nor the names of other
+//     contributors may be used to endorse or promote products derived from
+//     this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+// IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+// TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+// PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+// TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+// NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// ----------------------------------------------------------------------------
+
+#include "DirReader.hpp"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "Stats.hpp"
+
+#ifdef __linux__
+#include <sys/syscall.h>
+#endif
+
+namespace
+{
+
+size_t const bufferSize = 128*1024;
+
+#ifdef __linux__
+struct LinuxDirent64
+{
+    ino64_t d_ino;
+    off64_t d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name[256];
+};
+#endif
+
+bool isDotOrDotDot(char const* name)
+{
+    return name[0] == '.' && (name[1] == '\0' || (name[1] == '.' && name[2] == '\0'));
+}
+
+}
+
+// ----------------------------------------------------------------------------
+
+int openDirectory(int dirFd, char const* name, bool followLink)
+{
+    int flags = O_RDONLY | O_DIRECTORY | O_CLOEXEC;
+    if (!followLink)
+        flags |= O_NOFOLLOW;
+    countSysCall(openCall);
+    return openat(dirFd, name, flags);
+} // openDirectory
+
+// ----------------------------------------------------------------------------
+
+DirReader::DirReader(int fd, std::vector<char>& buffer)
+    : myFd(fd),
+      myBuffer(&buffer),
+      myPos(0),
+      myEnd(0),
+      myName(NULL),
+      myType(DT_UNKNOWN),
+      myInode(0),
+      myError(0),
+      myDir(NULL)
+{
+#ifdef __linux__
+    if (myBuffer->size() < bufferSize)
+        myBuffer->resize(bufferSize);
+#else
+    int copy = dup(fd);
+    if (copy >= 0) {
+        myDir = fdopendir(copy);
+        if (myDir == NULL)
+            close(copy);
+    }
+    if (myDir == NULL)
+        myError = errno;
+#endif
+} // DirReader
+
+// ----------------------------------------------------------------------------
+
+DirReader::~DirReader()
+{
+    if (myDir != NULL)
+        closedir(myDir);
+} // ~DirReader
+
+// ----------------------------------------------------------------------------
+
+bool DirReader::next()
+{
+    for (;;) {
+        if (!fetch())
+            return false;
+        if (!isDotOrDotDot(myName))
+            return true;
+    }
+} // next
+
+// ----------------------------------------------------------------------------
+
+bool DirReader::fetch()
+{
+    if (myError != 0)
+        return false;
+#ifdef __linux__
+    if (myPos >= myEnd) {
+        countSysCall(getdentsCall);
+        long count = syscall(SYS_getdents64, myFd, &(*myBuffer)[0], myBuffer->size());
+        if (count < 0) {
+            myError = errno;
+            return false;
+        }
+        if (count == 0)
+            return false;
+        myPos = 0;
+        myEnd = size_t(count);
+    }
+    LinuxDirent64 const* entry
+        = reinterpret_cast<LinuxDirent64 const*>(&(*myBuffer)[myPos]);
+    myPos += entry->d_reclen;
+    myName = entry->d_name;
+    myType = entry->d_type;
+    myInode = ino_t(entry->d_ino);
+    return true;
+#else
+    errno = 0;
+    countSysCall(getdentsCall);
+    dirent* entry = readdir(myDir);
+    if (entry == NULL) {
+        myError = errno;
+        return false;
+    }
+    myName = entry->d_name;
+    myType = entry->d_type;
+    myInode = entry->d_ino;
+    return true;
+#endif
+} // fetch
+
+// ----------------------------------------------------------------------------
+
+char const* DirReader::name() const
+{
+    return myName;
+} // name
+
+// ----------------------------------------------------------------------------
+
+unsigned char DirReader::type() const
+{
+    return myType;
+} // type
+
+// ----------------------------------------------------------------------------
+
+ino_t DirReader::inode() const
+{
+    return myInode;
+} // inode
+
+// ----------------------------------------------------------------------------
+
+int DirReader::error() const
+{
+    return myError;
+} // error
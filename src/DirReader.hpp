@@ -0,0 +1,97 @@
+// DirReader.hpp
+//
+// ----------------------------------------------------------------------------
+//
+// Copyright (C) 2021  Jean-Marc Bourguet
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//   * Redistributions of source code must retain the above copyright
+//     notice, this list of conditions and the following disclaimer.
+//
+//   * Redistributions in binary form must reproduce the above copyright
+//     notice, this list of conditions and the following disclaimer in the
+//     documentation and/or other materials provided with the distribution.
+//
+//   * Neither the name of Jean-Marc Bourguet nor the names of other
+//     contributors may be used to endorse or promote products derived from
+//     this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+// IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+// TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+// PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+// TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+// NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+// ----------------------------------------------------------------------------
+//
+// Iterate over the entries of an open directory.  On Linux the entries are
+// fetched with getdents64 into a caller provided buffer, so that a large
+// directory needs only a few system calls; elsewhere readdir is used.
+//
+// ----------------------------------------------------------------------------
+
+#ifndef DIR_READER_HPP
+#define DIR_READER_HPP
+
+#include <dirent.h>
+#include <sys/types.h>
+#include <vector>
+
+// ----------------------------------------------------------------------------
+
+/// Open the directory name relative to dirFd (which may be AT_FDCWD).
+/// Symbolic links are followed only if followLink is true.  Returns -1 and
+/// sets errno on failure.
+int openDirectory(int dirFd, char const* name, bool followLink);
+
+// ----------------------------------------------------------------------------
+// DirReader
+// ----------------------------------------------------------------------------
+
+class DirReader
+{
+public:
+    /// fd is not closed by the reader
+    DirReader(int fd, std::vector<char>& buffer);
+    ~DirReader();
+
+    /// Advance to the next entry other than . and ..; returns false at the
+    /// end or on error, in which case error() is the errno value.
+    bool next();
+
+    char const* name() const;
+    unsigned char type() const;
+    ino_t inode() const;
+    int error() const;
+private: // and not implemented
+    DirReader(DirReader const&);
+    DirReader& operator=(DirReader const&);
+
+private:
+    bool fetch();
+
+    int myFd;
+    std::vector<char>* myBuffer;
+    size_t myPos;
+    size_t myEnd;
+    char const* myName;
+    unsigned char myType;
+    ino_t myInode;
+    int myError;
+    DIR* myDir;
+}; // DirReader
+
+// ----------------------------------------------------------------------------
+
+#endif
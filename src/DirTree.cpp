@@ -0,0 +1,496 @@
+// DirTree.cpp
+//
+// ----------------------------------------------------------------------------
+//
+// Copyright (C) 2021  Jean-Marc Bourguet
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//   * Redistributions of source code must retain the above copyright
+//     notice, this list of conditions and the following disclaimer.
+//
+//   * Redistributions in binary form must reproduce the above copyright
+//     notice, this list of conditions and the following disclaimer in the
+//     documentation and/or other materials provided with the distribution.
+//
+//   * Neither the name of Jean-Marc Bourguet nor the names of other
+//     contributors may be used to endorse or promote products derived from
+//     this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+// IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+// TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+// PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+// TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+// NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// ----------------------------------------------------------------------------
+
+#include "DirTree.hpp"
+
+#include <stdexcept>
+#include <string.h>
+
+// ----------------------------------------------------------------------------
+
+DirTree::Index const DirTree::none;
+uint64_t const DirTree::noName;
+
+// ----------------------------------------------------------------------------
+
+DirTree::DirTree()
+    : myKeepHistograms(false),
+      myLogical(false),
+      myLastRoot(none)
+{
+} // DirTree
+
+// ----------------------------------------------------------------------------
+
+DirTree::Index DirTree::addDirectory(char const* name, Index parent, Index previous)
+{
+    std::lock_guard<std::mutex> lock(myMutex);
+    if (parent == none) {
+        previous = myLastRoot;
+    }
+    Index result = allocate(parent, previous);
+    myNames[result] = intern(name);
+    if (parent == none) {
+        myLastRoot = result;
+    }
+    return result;
+} // addDirectory
+
+// ----------------------------------------------------------------------------
+
+DirTree::Index DirTree::addContent(Index parent, Index previous)
+{
+    std::lock_guard<std::mutex> lock(myMutex);
+    Index result = allocate(parent, previous);
+    myFlags[result] = contentFlag;
+    return result;
+} // addContent
+
+// ----------------------------------------------------------------------------
+
+DirTree::Index DirTree::allocate(Index parent, Index previous)
+{
+    Index result;
+    if (!myFreeNodes.empty()) {
+        result = myFreeNodes.back();
+        myFreeNodes.pop_back();
+    } else {
+        size_t const i = mySizes.grow(1);
+        if (i >= none)
+            throw std::length_error("Too many directories");
+        myDirectSizes.grow(1);
+        myParents.grow(1);
+        myFirstChildren.grow(1);
+        myNextSiblings.grow(1);
+        myNames.grow(1);
+        myMaxEntryNames.grow(1);
+        myMaxEntrySizes.grow(1);
+        myFlags.grow(1);
+        myDevices.grow(1);
+        myInodes.grow(1);
+        myModified.grow(1);
+        myChanged.grow(1);
+        myOtherSizes.grow(1);
+        myOtherDirectSizes.grow(1);
+        myFiles.grow(1);
+        myDirectFiles.grow(1);
+        if (myKeepHistograms)
+            myHistograms.grow(1);
+        result = Index(i);
+    }
+
+    mySizes[result] = 0;
+    myDirectSizes[result] = 0;
+    myParents[result] = parent;
+    myFirstChildren[result] = none;
+    myNextSiblings[result] = none;
+    myNames[result] = noName;
+    myMaxEntryNames[result] = noName;
+    myMaxEntrySizes[result] = 0;
+    myFlags[result] = 0;
+    myDevices[result] = 0;
+    myInodes[result] = 0;
+    myModified[result] = 0;
+    myChanged[result] = 0;
+    myOtherSizes[result] = 0;
+    myOtherDirectSizes[result] = 0;
+    myFiles[result] = 0;
+    myDirectFiles[result] = 0;
+    if (myKeepHistograms)
+        myHistograms[result] = Histogram();
+    if (previous != none) {
+        myNextSiblings[previous] = result;
+    } else if (parent != none) {
+        myFirstChildren[parent] = result;
+    }
+    return result;
+} // allocate
+
+// ----------------------------------------------------------------------------
+
+void DirTree::remove(Index i, Index previous)
+{
+    Index const next = myNextSiblings[i];
+    if (previous != none) {
+        myNextSiblings[previous] = next;
+    } else {
+        myFirstChildren[myParents[i]] = next;
+    }
+    std::lock_guard<std::mutex> lock(myMutex);
+    release(i);
+} // remove
+
+// ----------------------------------------------------------------------------
+
+void DirTree::release(Index i)
+{
+    for (Index child = myFirstChildren[i]; child != none; child = myNextSiblings[child]) {
+        release(child);
+    }
+    releaseName(myNames[i]);
+    releaseName(myMaxEntryNames[i]);
+    myFreeNodes.push_back(i);
+} // release
+
+// ----------------------------------------------------------------------------
+
+void DirTree::releaseName(uint64_t offset)
+{
+    if (offset == noName)
+        return;
+    size_t const length = strlen(&myStrings[offset]) + 1;
+    if (length >= myFreeNames.size())
+        myFreeNames.resize(length + 1);
+    myFreeNames[length].push_back(offset);
+} // releaseName
+
+// ----------------------------------------------------------------------------
+
+uint64_t DirTree::intern(char const* name)
+{
+    size_t const length = strlen(name) + 1;
+    if (length < myFreeNames.size() && !myFreeNames[length].empty()) {
+        uint64_t const result = myFreeNames[length].back();
+        myFreeNames[length].pop_back();
+        memcpy(&myStrings[result], name, length);
+        return result;
+    }
+    size_t const end = myStrings.size();
+    size_t const result = myStrings.grow(length);
+    if (result != end) {
+        // the end of the segment has been skipped, clear it as it is
+        // saved with the rest
+        memset(&myStrings[end], 0, result - end);
+    }
+    memcpy(&myStrings[result], name, length);
+    return result;
+} // intern
+
+// ----------------------------------------------------------------------------
+
+size_t DirTree::nodeCount() const
+{
+    return mySizes.size();
+} // nodeCount
+
+// ----------------------------------------------------------------------------
+
+size_t DirTree::freeCount() const
+{
+    return myFreeNodes.size();
+} // freeCount
+
+// ----------------------------------------------------------------------------
+
+void DirTree::keepHistograms()
+{
+    myKeepHistograms = true;
+} // keepHistograms
+
+// ----------------------------------------------------------------------------
+
+bool DirTree::isLogical() const
+{
+    return myLogical;
+} // isLogical
+
+// ----------------------------------------------------------------------------
+
+void DirTree::setLogical(bool logical)
+{
+    myLogical = logical;
+} // setLogical
+
+// ----------------------------------------------------------------------------
+
+size_t DirTree::memoryUsed() const
+{
+    return mySizes.memoryUsed() + myDirectSizes.memoryUsed()
+        + myParents.memoryUsed() + myFirstChildren.memoryUsed()
+        + myNextSiblings.memoryUsed() + myNames.memoryUsed()
+        + myMaxEntryNames.memoryUsed() + myMaxEntrySizes.memoryUsed()
+        + myFlags.memoryUsed() + myDevices.memoryUsed()
+        + myInodes.memoryUsed() + myModified.memoryUsed()
+        + myChanged.memoryUsed() + myOtherSizes.memoryUsed()
+        + myOtherDirectSizes.memoryUsed() + myFiles.memoryUsed()
+        + myDirectFiles.memoryUsed() + myStrings.memoryUsed()
+        + myHistograms.memoryUsed();
+} // memoryUsed
+
+// ----------------------------------------------------------------------------
+
+DirTree::Index DirTree::firstRoot() const
+{
+    return nodeCount() > 0 ? 0 : none;
+} // firstRoot
+
+// ----------------------------------------------------------------------------
+
+bool DirTree::isContent(Index i) const
+{
+    return (myFlags[i] & contentFlag) != 0;
+} // isContent
+
+// ----------------------------------------------------------------------------
+
+char const* DirTree::name(Index i) const
+{
+    return myNames[i] == noName ? "" : &myStrings[myNames[i]];
+} // name
+
+// ----------------------------------------------------------------------------
+
+DirTree::Index DirTree::parent(Index i) const
+{
+    return myParents[i];
+} // parent
+
+// ----------------------------------------------------------------------------
+
+DirTree::Index DirTree::firstChild(Index i) const
+{
+    return myFirstChildren[i];
+} // firstChild
+
+// ----------------------------------------------------------------------------
+
+DirTree::Index DirTree::nextSibling(Index i) const
+{
+    return myNextSiblings[i];
+} // nextSibling
+
+// ----------------------------------------------------------------------------
+
+size_t DirTree::size(Index i) const
+{
+    return mySizes[i];
+} // size
+
+// ----------------------------------------------------------------------------
+
+size_t DirTree::directSize(Index i) const
+{
+    return myDirectSizes[i];
+} // directSize
+
+// ----------------------------------------------------------------------------
+
+size_t DirTree::otherSize(Index i) const
+{
+    return myOtherSizes[i];
+} // otherSize
+
+// ----------------------------------------------------------------------------
+
+size_t DirTree::otherDirectSize(Index i) const
+{
+    return myOtherDirectSizes[i];
+} // otherDirectSize
+
+// ----------------------------------------------------------------------------
+
+size_t DirTree::files(Index i) const
+{
+    return myFiles[i];
+} // files
+
+// ----------------------------------------------------------------------------
+
+size_t DirTree::directFiles(Index i) const
+{
+    return myDirectFiles[i];
+} // directFiles
+
+// ----------------------------------------------------------------------------
+
+Histogram const* DirTree::histogram(Index i) const
+{
+    return myKeepHistograms ? &myHistograms[i] : NULL;
+} // histogram
+
+// ----------------------------------------------------------------------------
+
+Histogram* DirTree::histogram(Index i)
+{
+    return myKeepHistograms ? &myHistograms[i] : NULL;
+} // histogram
+
+// ----------------------------------------------------------------------------
+
+char const* DirTree::maxEntryName(Index i) const
+{
+    return myMaxEntryNames[i] == noName ? NULL : &myStrings[myMaxEntryNames[i]];
+} // maxEntryName
+
+// ----------------------------------------------------------------------------
+
+size_t DirTree::maxEntrySize(Index i) const
+{
+    return myMaxEntrySizes[i];
+} // maxEntrySize
+
+// ----------------------------------------------------------------------------
+
+bool DirTree::isIncomplete(Index i) const
+{
+    return (myFlags[i] & incompleteFlag) != 0;
+} // isIncomplete
+
+// ----------------------------------------------------------------------------
+
+bool DirTree::isMountPoint(Index i) const
+{
+    return (myFlags[i] & mountPointFlag) != 0;
+} // isMountPoint
+
+// ----------------------------------------------------------------------------
+
+bool DirTree::isOtherRoot(Index i) const
+{
+    return (myFlags[i] & otherRootFlag) != 0;
+} // isOtherRoot
+
+// ----------------------------------------------------------------------------
+
+uint64_t DirTree::device(Index i) const
+{
+    return myDevices[i];
+} // device
+
+// ----------------------------------------------------------------------------
+
+uint64_t DirTree::inode(Index i) const
+{
+    return myInodes[i];
+} // inode
+
+// ----------------------------------------------------------------------------
+
+int64_t DirTree::modified(Index i) const
+{
+    return myModified[i];
+} // modified
+
+// ----------------------------------------------------------------------------
+
+int64_t DirTree::changed(Index i) const
+{
+    return myChanged[i];
+} // changed
+
+// ----------------------------------------------------------------------------
+
+void DirTree::setSize(Index i, size_t size)
+{
+    mySizes[i] = size;
+} // setSize
+
+// ----------------------------------------------------------------------------
+
+void DirTree::setDirectSize(Index i, size_t size)
+{
+    myDirectSizes[i] = size;
+} // setDirectSize
+
+// ----------------------------------------------------------------------------
+
+void DirTree::setOtherSize(Index i, size_t size)
+{
+    myOtherSizes[i] = size;
+} // setOtherSize
+
+// ----------------------------------------------------------------------------
+
+void DirTree::setOtherDirectSize(Index i, size_t size)
+{
+    myOtherDirectSizes[i] = size;
+} // setOtherDirectSize
+
+// ----------------------------------------------------------------------------
+
+void DirTree::setFiles(Index i, size_t count)
+{
+    myFiles[i] = count;
+} // setFiles
+
+// ----------------------------------------------------------------------------
+
+void DirTree::setDirectFiles(Index i, size_t count)
+{
+    myDirectFiles[i] = count;
+} // setDirectFiles
+
+// ----------------------------------------------------------------------------
+
+void DirTree::setMaxEntry(Index i, char const* name, size_t size)
+{
+    std::lock_guard<std::mutex> lock(myMutex);
+    releaseName(myMaxEntryNames[i]);
+    myMaxEntryNames[i] = name == NULL ? noName : intern(name);
+    myMaxEntrySizes[i] = size;
+} // setMaxEntry
+
+// ----------------------------------------------------------------------------
+
+void DirTree::setIncomplete(Index i)
+{
+    myFlags[i] = uint8_t(myFlags[i] | incompleteFlag);
+} // setIncomplete
+
+// ----------------------------------------------------------------------------
+
+void DirTree::setMountPoint(Index i)
+{
+    myFlags[i] = uint8_t(myFlags[i] | mountPointFlag);
+} // setMountPoint
+
+// ----------------------------------------------------------------------------
+
+void DirTree::setOtherRoot(Index i)
+{
+    myFlags[i] = uint8_t(myFlags[i] | otherRootFlag);
+} // setOtherRoot
+
+// ----------------------------------------------------------------------------
+
+void DirTree::setIdentity(Index i, uint64_t device, uint64_t inode,
+                          int64_t modified, int64_t changed)
+{
+    myDevices[i] = device;
+    myInodes[i] = inode;
+    myModified[i] = modified;
+    myChanged[i] = changed;
+} // setIdentity
@@ -0,0 +1,196 @@
+// DirTree.hpp
+//
+// ----------------------------------------------------------------------------
+//
+// Copyright (C) 2021  Jean-Marc Bourguet
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//   * Redistributions of source code must retain the above copyright
+//     notice, this list of conditions and the following disclaimer.
+//
+//   * Redistributions in binary form must reproduce the above copyright
+//     notice, this list of conditions and the following disclaimer in the
+//     documentation and/or other materials provided with the distribution.
+//
+//   * Neither the name of Jean-Marc Bourguet nor the names of other
+//     contributors may be used to endorse or promote products derived from
+//     this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+// IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+// TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+// PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+// TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+// NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+// ----------------------------------------------------------------------------
+//
+//
+// Storage for the collected directory information: an arena keeping each
+// field of the nodes in its own array (sizes, parent, first child and next
+// sibling indices, ...) and the names in a single string pool.  Nodes are
+// identified by their index; DirInfo gives the usual view on them.
+//
+// Adding nodes is thread safe.  The other fields of a node are written only
+// by the thread scanning the corresponding directory.
+//
+// A Histogram may be kept for each node; as it is the biggest field by far,
+// it is optional.
+//
+// Removed nodes are kept on a free list, and their names on free lists by
+// length, to be reused by the next additions: the arrays don't grow while
+// as many nodes are removed as added.
+//
+// ----------------------------------------------------------------------------
+
+#ifndef DIR_TREE_HPP
+#define DIR_TREE_HPP
+
+#include <mutex>
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+#include "Histogram.hpp"
+#include "SegmentedArray.hpp"
+
+// ----------------------------------------------------------------------------
+// DirTree
+// ----------------------------------------------------------------------------
+
+class DirTree
+{
+public:
+    typedef uint32_t Index;
+    static Index const none = 0xFFFFFFFFU;
+
+    DirTree();
+
+    /// Add a directory node, as the child of parent following previous (or
+    /// as first child if previous is none).  parent is none for a root, the
+    /// roots are chained as siblings.
+    Index addDirectory(char const* name, Index parent, Index previous);
+    /// Add the node representing the content of parent
+    Index addContent(Index parent, Index previous);
+    /// Remove i, which isn't a root, and its subtree from the children of
+    /// its parent, previous being the sibling before i (none if i is the
+    /// first child).  Only the thread owning the parent may call it.
+    void remove(Index i, Index previous);
+
+    /// nodes allocated, including the removed ones not reused yet
+    size_t nodeCount() const;
+    /// removed nodes not reused yet
+    size_t freeCount() const;
+    /// Keep a Histogram for each node; to be called before adding any.
+    void keepHistograms();
+    /// whether the sizes are logical ones, in bytes, rather than physical
+    /// ones, in blocks; to be set before adding nodes
+    bool isLogical() const;
+    void setLogical(bool logical);
+    Index firstRoot() const;
+    /// bytes allocated for the nodes and their names
+    size_t memoryUsed() const;
+
+    bool isContent(Index i) const;
+    char const* name(Index i) const;
+    Index parent(Index i) const;
+    Index firstChild(Index i) const;
+    Index nextSibling(Index i) const;
+    size_t size(Index i) const;
+    size_t directSize(Index i) const;
+    /// the sizes of the other kind than size: physical ones if size is
+    /// logical, and conversely
+    size_t otherSize(Index i) const;
+    size_t otherDirectSize(Index i) const;
+    /// number of files (entries which aren't directories) in the subtree
+    /// and directly in the directory
+    size_t files(Index i) const;
+    size_t directFiles(Index i) const;
+    /// NULL if histograms aren't kept
+    Histogram const* histogram(Index i) const;
+    Histogram* histogram(Index i);
+    /// NULL if none has been recorded
+    char const* maxEntryName(Index i) const;
+    size_t maxEntrySize(Index i) const;
+    /// some error prevented to get the full content of the directory
+    bool isIncomplete(Index i) const;
+    /// another file system is mounted on the directory, which hasn't been
+    /// read
+    bool isMountPoint(Index i) const;
+    /// the directory is also one of the roots and hasn't been read here
+    bool isOtherRoot(Index i) const;
+    /// identity and times (ns since the epoch) of the directory
+    uint64_t device(Index i) const;
+    uint64_t inode(Index i) const;
+    int64_t modified(Index i) const;
+    int64_t changed(Index i) const;
+
+    void setSize(Index i, size_t size);
+    void setDirectSize(Index i, size_t size);
+    void setOtherSize(Index i, size_t size);
+    void setOtherDirectSize(Index i, size_t size);
+    void setFiles(Index i, size_t count);
+    void setDirectFiles(Index i, size_t count);
+    /// name replaces the previous one, NULL removes it
+    void setMaxEntry(Index i, char const* name, size_t size);
+    void setIncomplete(Index i);
+    void setMountPoint(Index i);
+    void setOtherRoot(Index i);
+    void setIdentity(Index i, uint64_t device, uint64_t inode,
+                     int64_t modified, int64_t changed);
+private: // and not implemented
+    DirTree(DirTree const&);
+    DirTree& operator=(DirTree const&);
+
+private:
+    friend class Snapshot;
+
+    enum { contentFlag = 1, incompleteFlag = 2, mountPointFlag = 4, otherRootFlag = 8 };
+
+    static uint64_t const noName = ~uint64_t(0);
+
+    Index allocate(Index parent, Index previous);
+    uint64_t intern(char const* name);
+    void release(Index i);
+    void releaseName(uint64_t offset);
+
+    std::mutex myMutex;
+    SegmentedArray<uint64_t, 10> mySizes;
+    SegmentedArray<uint64_t, 10> myDirectSizes;
+    SegmentedArray<Index, 10> myParents;
+    SegmentedArray<Index, 10> myFirstChildren;
+    SegmentedArray<Index, 10> myNextSiblings;
+    SegmentedArray<uint64_t, 10> myNames;
+    SegmentedArray<uint64_t, 10> myMaxEntryNames;
+    SegmentedArray<uint64_t, 10> myMaxEntrySizes;
+    SegmentedArray<uint8_t, 10> myFlags;
+    SegmentedArray<uint64_t, 10> myDevices;
+    SegmentedArray<uint64_t, 10> myInodes;
+    SegmentedArray<int64_t, 10> myModified;
+    SegmentedArray<int64_t, 10> myChanged;
+    SegmentedArray<uint64_t, 10> myOtherSizes;
+    SegmentedArray<uint64_t, 10> myOtherDirectSizes;
+    SegmentedArray<uint64_t, 10> myFiles;
+    SegmentedArray<uint64_t, 10> myDirectFiles;
+    SegmentedArray<char, 16> myStrings;
+    SegmentedArray<Histogram, 10> myHistograms;
+    bool myKeepHistograms;
+    bool myLogical;
+    Index myLastRoot;
+    std::vector<Index> myFreeNodes;
+    std::vector<std::vector<uint64_t> > myFreeNames; // by length, NUL included
+}; // DirTree
+
+// ----------------------------------------------------------------------------
+
+#endif
@@ -0,0 +1,152 @@
+// FileStat.cpp
+//
+// ----------------------------------------------------------------------------
+//
+// Copyright (C) 2021  Jean-Marc Bourguet
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//   * Redistributions of source code must retain the above copyright
+//     notice, this list of conditions and the following disclaimer.
+//
+//   * Redistributions in binary form must reproduce the above copyright
+//     notice, this list of conditions and the following disclaimer in the
+//     documentation and/or other materials provided with the distribution.
+//
+//   * Neither the name of Jean-Marc Bourguet nor the names of other
+//     contributors may be used to endorse or promote products derived from
+//     this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+// IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+// TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+// PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+// TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+// NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// ----------------------------------------------------------------------------
+
+#include "FileStat.hpp"
+
+#include <atomic>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/sysmacros.h>
+
+#include "Stats.hpp"
+
+namespace
+{
+
+#ifdef STATX_BASIC_STATS
+unsigned int const wantedFields
+    = STATX_TYPE | STATX_SIZE | STATX_BLOCKS | STATX_INO | STATX_NLINK
+    | STATX_MTIME | STATX_CTIME;
+
+// cleared the first time the kernel tells us it doesn't know statx
+std::atomic<bool> theHasStatx(true);
+#endif
+
+void fromStat(struct stat const& buf, FileInfo& info)
+{
+    info.isDirectory = S_ISDIR(buf.st_mode);
+    info.size = static_cast<unsigned long long>(buf.st_size);
+    info.blocks = static_cast<unsigned long long>(buf.st_blocks);
+    info.inode = buf.st_ino;
+    info.device = buf.st_dev;
+    info.links = buf.st_nlink;
+    info.modified = buf.st_mtim.tv_sec * 1000000000LL + buf.st_mtim.tv_nsec;
+    info.changed = buf.st_ctim.tv_sec * 1000000000LL + buf.st_ctim.tv_nsec;
+}
+
+#ifdef STATX_BASIC_STATS
+/// 0 on success, -1 on failure, 1 if statx can't be used
+int tryStatx(int dirFd, char const* name, int flags, FileInfo& info)
+{
+    if (!theHasStatx)
+        return 1;
+    struct statx buf;
+    countSysCall(statxCall);
+    if (statx(dirFd, name, flags, wantedFields, &buf) != 0) {
+        if (errno != ENOSYS)
+            return -1;
+        theHasStatx = false;
+        return 1;
+    }
+    return fromStatx(buf, info) ? 0 : 1;
+}
+#endif
+
+}
+
+// ----------------------------------------------------------------------------
+
+#ifdef STATX_BASIC_STATS
+unsigned int statxFields()
+{
+    return wantedFields;
+} // statxFields
+
+// ----------------------------------------------------------------------------
+
+bool fromStatx(struct statx const& buf, FileInfo& info)
+{
+    if ((buf.stx_mask & wantedFields) != wantedFields) {
+        // some file systems don't provide everything, the stat family will
+        // do its best
+        return false;
+    }
+    info.isDirectory = S_ISDIR(buf.stx_mode);
+    info.size = buf.stx_size;
+    info.blocks = buf.stx_blocks;
+    info.inode = buf.stx_ino;
+    info.device = makedev(buf.stx_dev_major, buf.stx_dev_minor);
+    info.links = buf.stx_nlink;
+    info.modified = buf.stx_mtime.tv_sec * 1000000000LL + buf.stx_mtime.tv_nsec;
+    info.changed = buf.stx_ctime.tv_sec * 1000000000LL + buf.stx_ctime.tv_nsec;
+    return true;
+} // fromStatx
+#endif
+
+// ----------------------------------------------------------------------------
+
+int statEntry(int dirFd, char const* name, FileInfo& info)
+{
+#ifdef STATX_BASIC_STATS
+    int status = tryStatx(dirFd, name, AT_SYMLINK_NOFOLLOW, info);
+    if (status <= 0)
+        return status;
+#endif
+    struct stat buf;
+    countSysCall(statCall);
+    if (fstatat(dirFd, name, &buf, AT_SYMLINK_NOFOLLOW) != 0)
+        return -1;
+    fromStat(buf, info);
+    return 0;
+} // statEntry
+
+// ----------------------------------------------------------------------------
+
+int statDescriptor(int fd, FileInfo& info)
+{
+#ifdef STATX_BASIC_STATS
+    int status = tryStatx(fd, "", AT_EMPTY_PATH, info);
+    if (status <= 0)
+        return status;
+#endif
+    struct stat buf;
+    countSysCall(statCall);
+    if (fstat(fd, &buf) != 0)
+        return -1;
+    fromStat(buf, info);
+    return 0;
+} // statDescriptor
@@ -0,0 +1,85 @@
+// FileStat.hpp
+//
+// ----------------------------------------------------------------------------
+//
+// Copyright (C) 2021  Jean-Marc Bourguet
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//   * Redistributions of source code must retain the above copyright
+//     notice, this list of conditions and the following disclaimer.
+//
+//   * Redistributions in binary form must reproduce the above copyright
+//     notice, this list of conditions and the following disclaimer in the
+//     documentation and/or other materials provided with the distribution.
+//
+//   * Neither the name of Jean-Marc Bourguet nor the names of other
+//     contributors may be used to endorse or promote products derived from
+//     this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+// IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+// TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+// PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+// TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+// NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+// ----------------------------------------------------------------------------
+//
+// The part of the file metadata dirsize uses.  When available, statx is
+// used and asked only for those fields, otherwise fstatat.
+//
+// ----------------------------------------------------------------------------
+
+#ifndef FILE_STAT_HPP
+#define FILE_STAT_HPP
+
+#include <sys/types.h>
+
+// ----------------------------------------------------------------------------
+// FileInfo
+// ----------------------------------------------------------------------------
+
+struct FileInfo
+{
+    bool isDirectory;
+    unsigned long long size;   // logical size in bytes
+    unsigned long long blocks; // allocated 512 bytes blocks
+    ino_t inode;
+    dev_t device;
+    nlink_t links;
+    long long modified; // ns since the epoch
+    long long changed;  // idem
+}; // FileInfo
+
+// ----------------------------------------------------------------------------
+
+/// Get information about name relative to dirFd, without following a
+/// symbolic link.  Returns -1 and sets errno on failure.
+int statEntry(int dirFd, char const* name, FileInfo& info);
+
+/// Get information about an open file.
+int statDescriptor(int fd, FileInfo& info);
+
+// For those issuing statx themselves (only defined when statx is
+// available).
+struct statx;
+
+/// The fields to ask statx for
+unsigned int statxFields();
+
+/// Fill info from the result of statx, false if a needed field is missing
+bool fromStatx(struct statx const& buf, FileInfo& info);
+
+// ----------------------------------------------------------------------------
+
+#endif
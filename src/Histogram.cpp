@@ -0,0 +1,294 @@
+// Histogram.cpp
+//
+// ----------------------------------------------------------------------------
+//
+// Copyright (C) 2021  Jean-Marc Bourguet
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//   * Redistributions of source code must retain the above copyright
+//     notice, this list of conditions and the following disclaimer.
+//
+//   * Redistributions in binary form must reproduce the above copyright
+//     notice, this list of conditions and the following disclaimer in the
+//     documentation and/or other materials provided with the distribution.
+//
+//   * Neither the name of Jean-Marc Bourguet nor the names of other
+//     contributors may be used to endorse or promote products derived from
+//     this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+// IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+// TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+// PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+// TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+// NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// ----------------------------------------------------------------------------
+
+#include "Histogram.hpp"
+
+#include <ctype.h>
+#include <stdint.h>
+#include <string.h>
+
+namespace
+{
+
+enum { noType, sourceType, objectType, archiveType, imageType, mediaType,
+       documentType, dataType, otherType };
+
+size_t const longestExtension = 8; // longer ones are not extensions
+
+struct ExtensionType
+{
+    char const* extension;
+    size_t type;
+};
+
+/// sorted by extension
+ExtensionType const theExtensionTypes[] = {
+    { "7z", archiveType }, { "a", objectType }, { "avi", mediaType },
+    { "bin", dataType }, { "bmp", imageType }, { "bz2", archiveType },
+    { "c", sourceType }, { "cc", sourceType }, { "class", objectType },
+    { "cpp", sourceType }, { "cs", sourceType }, { "csv", dataType },
+    { "cxx", sourceType }, { "dat", dataType }, { "db", dataType },
+    { "deb", archiveType }, { "dll", objectType }, { "doc", documentType },
+    { "docx", documentType }, { "epub", documentType }, { "exe", objectType },
+    { "flac", mediaType }, { "gif", imageType }, { "go", sourceType },
+    { "gz", archiveType }, { "h", sourceType }, { "hh", sourceType },
+    { "hpp", sourceType }, { "htm", documentType }, { "html", documentType },
+    { "ico", imageType }, { "iso", archiveType }, { "jar", archiveType },
+    { "java", sourceType }, { "jpeg", imageType }, { "jpg", imageType },
+    { "js", sourceType }, { "json", dataType }, { "ko", objectType },
+    { "log", dataType }, { "md", documentType }, { "mkv", mediaType },
+    { "mov", mediaType }, { "mp3", mediaType }, { "mp4", mediaType },
+    { "o", objectType }, { "obj", objectType }, { "odt", documentType },
+    { "ogg", mediaType }, { "parquet", dataType }, { "pdf", documentType },
+    { "pl", sourceType }, { "pm", sourceType }, { "png", imageType },
+    { "ps", documentType }, { "py", sourceType }, { "pyc", objectType },
+    { "rar", archiveType }, { "rb", sourceType }, { "rpm", archiveType },
+    { "rs", sourceType }, { "rst", documentType }, { "sh", sourceType },
+    { "so", objectType }, { "sqlite", dataType }, { "svg", imageType },
+    { "tar", archiveType }, { "tex", documentType }, { "tgz", archiveType },
+    { "tif", imageType }, { "tiff", imageType }, { "ts", sourceType },
+    { "txt", documentType }, { "wav", mediaType }, { "webm", mediaType },
+    { "webp", imageType }, { "xml", dataType }, { "xz", archiveType },
+    { "yaml", dataType }, { "yml", dataType }, { "zip", archiveType },
+    { "zst", archiveType }
+};
+
+char const* const theSizeNames[Histogram::sizeClasses] = {
+    "<1K", "1K", "2K", "4K", "8K", "16K", "32K", "64K", "128K", "256K", "512K",
+    "1M", "2M", "4M", "8M", "16M", "32M", "64M", "128M", "256M", "512M",
+    "1G", "2G", "4G+"
+};
+
+char const* const theTypeNames[Histogram::typeClasses] = {
+    "none", "source", "object", "archive", "image", "media", "document", "data",
+    "other"
+};
+
+char const* const theAgeNames[Histogram::ageClasses] = {
+    "<1d", "<1w", "<1m", "<1y", "<5y", "older"
+};
+
+long long const day = 86400LL * 1000000000LL;
+
+/// upper bounds of the ages, but the last
+long long const theAgeLimits[Histogram::ageClasses - 1] = {
+    day, 7 * day, 30 * day, 365 * day, 5 * 365 * day
+};
+
+/// offset of the first class of kind in the counters
+size_t firstClass(Histogram::Kind kind)
+{
+    switch (kind) {
+    case Histogram::bySize:
+        return 0;
+    case Histogram::byType:
+        return Histogram::sizeClasses;
+    case Histogram::byAge:
+        break;
+    }
+    return Histogram::sizeClasses + Histogram::typeClasses;
+}
+
+}
+
+// ----------------------------------------------------------------------------
+
+Histogram::Histogram()
+{
+    memset(myFiles, 0, sizeof myFiles);
+    memset(mySizes, 0, sizeof mySizes);
+} // Histogram
+
+// ----------------------------------------------------------------------------
+
+void Histogram::add(std::string const& extension, unsigned long long length, size_t size,
+                    long long modified, long long now)
+{
+    count(sizeClass(length), size);
+    count(sizeClasses + typeClass(extension), size);
+    count(sizeClasses + typeClasses + ageClass(modified, now), size);
+} // add
+
+// ----------------------------------------------------------------------------
+
+void Histogram::count(size_t c, size_t size)
+{
+    if (myFiles[c] != UINT32_MAX)
+        ++myFiles[c];
+    mySizes[c] += size;
+} // count
+
+// ----------------------------------------------------------------------------
+
+void Histogram::merge(Histogram const& other)
+{
+    for (size_t c = 0; c < sizeClasses + typeClasses + ageClasses; ++c) {
+        uint64_t const files = uint64_t(myFiles[c]) + other.myFiles[c];
+        myFiles[c] = files > UINT32_MAX ? UINT32_MAX : uint32_t(files);
+        mySizes[c] += other.mySizes[c];
+    }
+} // merge
+
+// ----------------------------------------------------------------------------
+
+size_t Histogram::classCount(Kind kind)
+{
+    switch (kind) {
+    case bySize:
+        return sizeClasses;
+    case byType:
+        return typeClasses;
+    case byAge:
+        break;
+    }
+    return ageClasses;
+} // classCount
+
+// ----------------------------------------------------------------------------
+
+uint64_t Histogram::files(Kind kind, size_t c) const
+{
+    return myFiles[firstClass(kind) + c];
+} // files
+
+// ----------------------------------------------------------------------------
+
+uint64_t Histogram::size(Kind kind, size_t c) const
+{
+    return mySizes[firstClass(kind) + c];
+} // size
+
+// ----------------------------------------------------------------------------
+
+size_t Histogram::biggest(Kind kind) const
+{
+    size_t result = 0;
+    for (size_t c = 1; c < classCount(kind); ++c) {
+        if (size(kind, c) > size(kind, result))
+            result = c;
+    }
+    return result;
+} // biggest
+
+// ----------------------------------------------------------------------------
+
+char const* Histogram::className(Kind kind, size_t c)
+{
+    switch (kind) {
+    case bySize:
+        return theSizeNames[c];
+    case byType:
+        return theTypeNames[c];
+    case byAge:
+        break;
+    }
+    return theAgeNames[c];
+} // className
+
+// ----------------------------------------------------------------------------
+
+char const* Histogram::kindName(Kind kind)
+{
+    switch (kind) {
+    case bySize:
+        return "sizes";
+    case byType:
+        return "types";
+    case byAge:
+        break;
+    }
+    return "ages";
+} // kindName
+
+// ----------------------------------------------------------------------------
+
+size_t Histogram::sizeClass(unsigned long long length)
+{
+    // class c > 0 holds the lengths of c + 10 bits
+    size_t const bits = length == 0 ? 0 : size_t(64 - __builtin_clzll(length));
+    if (bits <= 10)
+        return 0;
+    return bits - 10 < sizeClasses ? bits - 10 : sizeClasses - 1;
+} // sizeClass
+
+// ----------------------------------------------------------------------------
+
+size_t Histogram::typeClass(std::string const& extension)
+{
+    if (extension.empty())
+        return noType;
+    size_t first = 0;
+    size_t last = sizeof theExtensionTypes / sizeof theExtensionTypes[0];
+    while (first < last) {
+        size_t const middle = first + (last - first) / 2;
+        int const cmp = strcmp(theExtensionTypes[middle].extension, extension.c_str());
+        if (cmp == 0)
+            return theExtensionTypes[middle].type;
+        if (cmp < 0) {
+            first = middle + 1;
+        } else {
+            last = middle;
+        }
+    }
+    return otherType;
+} // typeClass
+
+// ----------------------------------------------------------------------------
+
+size_t Histogram::ageClass(long long modified, long long now)
+{
+    long long const age = now - modified;
+    size_t result = 0;
+    while (result < ageClasses - 1 && age >= theAgeLimits[result]) {
+        ++result;
+    }
+    return result;
+} // ageClass
+
+// ----------------------------------------------------------------------------
+
+std::string Histogram::extension(char const* name)
+{
+    char const* dot = strrchr(name, '.');
+    // a leading dot marks a hidden file, not an extension
+    if (dot == NULL || dot == name || dot[1] == '\0' || strlen(dot + 1) > longestExtension)
+        return std::string();
+    std::string result(dot + 1);
+    for (size_t i = 0; i < result.size(); ++i) {
+        result[i] = char(tolower(static_cast<unsigned char>(result[i])));
+    }
+    return result;
+} // extension
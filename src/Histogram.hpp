@@ -0,0 +1,105 @@
+// Histogram.hpp
+//
+// ----------------------------------------------------------------------------
+//
+// Copyright (C) 2021  Jean-Marc Bourguet
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//   * Redistributions of source code must retain the above copyright
+//     notice, this list of conditions and the following disclaimer.
+//
+//   * Redistributions in binary form must reproduce the above copyright
+//     notice, this list of conditions and the following disclaimer in the
+//     documentation and/or other materials provided with the distribution.
+//
+//   * Neither the name of Jean-Marc Bourguet nor the names of other
+//     contributors may be used to endorse or promote products derived from
+//     this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+// IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+// TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+// PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+// TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+// NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+// ----------------------------------------------------------------------------
+//
+//
+// Distribution of the files of a subtree: by size (log2 classes of their
+// length), by type (guessed from their extension) and by age (of their
+// modification time, relatively to the start of the scan).  Each class
+// counts the files and their size, in the unit of the tree.  The counters
+// have a fixed size, so that a Histogram may be kept for each node, and
+// merging them is adding them, so that each thread may fill its own.
+//
+// ----------------------------------------------------------------------------
+
+#ifndef HISTOGRAM_HPP
+#define HISTOGRAM_HPP
+
+#include <map>
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <utility>
+
+// ----------------------------------------------------------------------------
+// Histogram
+// ----------------------------------------------------------------------------
+
+class Histogram
+{
+public:
+    enum { sizeClasses = 24, typeClasses = 9, ageClasses = 6 };
+    enum Kind { bySize, byType, byAge };
+    /// files and size by extension (lower case, empty for none)
+    typedef std::map<std::string, std::pair<uint64_t, uint64_t> > Extensions;
+
+    /// An empty histogram
+    Histogram();
+
+    /// Count a file with extension (as given by extension), of length
+    /// bytes and size (in the unit of the tree), modified at modified (ns
+    /// since the epoch, as now).
+    void add(std::string const& extension, unsigned long long length, size_t size,
+             long long modified, long long now);
+    void merge(Histogram const& other);
+
+    static size_t classCount(Kind kind);
+    /// number of files and their size in class c of kind
+    uint64_t files(Kind kind, size_t c) const;
+    uint64_t size(Kind kind, size_t c) const;
+    /// the class of kind with the biggest size
+    size_t biggest(Kind kind) const;
+
+    static char const* className(Kind kind, size_t c);
+    static char const* kindName(Kind kind);
+
+    static size_t sizeClass(unsigned long long length);
+    static size_t typeClass(std::string const& extension);
+    static size_t ageClass(long long modified, long long now);
+    /// the extension of name, lower case, without the dot ("" if none or
+    /// too long to be one)
+    static std::string extension(char const* name);
+private:
+    void count(size_t c, size_t size);
+
+    // classes of size, then of type, then of age; the file counts saturate
+    uint32_t myFiles[sizeClasses + typeClasses + ageClasses];
+    uint64_t mySizes[sizeClasses + typeClasses + ageClasses];
+}; // Histogram
+
+// ----------------------------------------------------------------------------
+
+#endif
@@ -0,0 +1,231 @@
+// IgnoreMatcher.cpp
+//
+// ----------------------------------------------------------------------------
+//
+// Copyright (C) 2021  Jean-Marc Bourguet
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//   * Redistributions of source code must retain the above copyright
+//     notice, this list of conditions and the following disclaimer.
+//
+//   * Redistributions in binary form must reproduce the above copyright
+//     notice, this list of conditions and the following disclaimer in the
+//     documentation and/or other materials provided with the distribution.
+//
+//   * Neither the name of Jean-Marc Bourguet nor the names of other
+//     contributors may be used to endorse or promote products derived from
+//     this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+// IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+// TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+// PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+// TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+// NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// ----------------------------------------------------------------------------
+
+#include "IgnoreMatcher.hpp"
+
+#include <fnmatch.h>
+#include <string.h>
+
+namespace
+{
+
+size_t const anyFirst = 256;
+
+bool isLiteral(char const* begin, char const* end)
+{
+    for (char const* p = begin; p != end; ++p) {
+        if (*p == '*' || *p == '?' || *p == '[' || *p == '\\')
+            return false;
+    }
+    return true;
+}
+
+/// whether pattern has a '/' out of a bracket expression, as a bracket
+/// expression never matches a '/' with FNM_PATHNAME
+bool hasSlash(std::string const& pattern)
+{
+    for (size_t i = 0; i < pattern.size(); ++i) {
+        if (pattern[i] == '/')
+            return true;
+        if (pattern[i] == '\\') {
+            ++i;
+        } else if (pattern[i] == '[') {
+            size_t end = i + 1;
+            if (end < pattern.size() && (pattern[end] == '!' || pattern[end] == '^'))
+                ++end;
+            if (end < pattern.size() && pattern[end] == ']')
+                ++end;
+            end = pattern.find(']', end);
+            if (end != std::string::npos)
+                i = end; // else the '[' is literal
+        }
+    }
+    return false;
+}
+
+}
+
+// ----------------------------------------------------------------------------
+
+IgnoreMatcher::IgnoreMatcher()
+    : myEmpty(true)
+{
+} // IgnoreMatcher
+
+// ----------------------------------------------------------------------------
+
+void IgnoreMatcher::add(std::string const& pattern)
+{
+    if (hasSlash(pattern)) {
+        myPathPatterns.add(pattern);
+    } else {
+        myNamePatterns.add(pattern);
+    }
+    myEmpty = false;
+} // add
+
+// ----------------------------------------------------------------------------
+
+bool IgnoreMatcher::empty() const
+{
+    return myEmpty;
+} // empty
+
+// ----------------------------------------------------------------------------
+
+bool IgnoreMatcher::matches(std::string const& name, std::string const& path) const
+{
+    if (myEmpty)
+        return false;
+    if (myNamePatterns.matches(name, name.size(), 0))
+        return true;
+    size_t const firstSlash = path.find('/');
+    if (firstSlash == std::string::npos)
+        return false; // not a path pattern can match it
+    return myPathPatterns.matches(path, firstSlash, path.rfind('/') + 1);
+} // matches
+
+// ----------------------------------------------------------------------------
+
+IgnoreMatcher::Set::Set()
+    : prefixes(1),
+      suffixes(1),
+      globs(anyFirst + 1),
+      hasPrefixes(false),
+      hasSuffixes(false),
+      hasGlobs(false)
+{
+} // Set
+
+// ----------------------------------------------------------------------------
+
+void IgnoreMatcher::Set::add(std::string const& pattern)
+{
+    char const* begin = pattern.c_str();
+    char const* end = begin + pattern.size();
+    if (isLiteral(begin, end)) {
+        literals.insert(pattern);
+    } else if (pattern.size() > 0 && end[-1] == '*' && isLiteral(begin, end - 1)) {
+        insert(prefixes, pattern.substr(0, pattern.size() - 1), false);
+        hasPrefixes = true;
+    } else if (pattern.size() > 0 && begin[0] == '*' && isLiteral(begin + 1, end)) {
+        insert(suffixes, pattern.substr(1), true);
+        hasSuffixes = true;
+    } else {
+        unsigned char const first = static_cast<unsigned char>(begin[0]);
+        globs[isLiteral(begin, begin + 1) ? first : anyFirst].push_back(pattern);
+        hasGlobs = true;
+    }
+} // add
+
+// ----------------------------------------------------------------------------
+
+void IgnoreMatcher::Set::insert(std::vector<Node>& trie, std::string const& key,
+                                bool reversed)
+{
+    uint32_t node = 0;
+    for (size_t i = 0; i < key.size(); ++i) {
+        unsigned char const c = static_cast<unsigned char>(reversed ? key[key.size() - 1 - i] : key[i]);
+        uint32_t next = child(trie, node, c);
+        if (next == 0) {
+            next = uint32_t(trie.size());
+            trie.push_back(Node());
+            trie[node].children.push_back(std::make_pair(c, next));
+        }
+        node = next;
+    }
+    trie[node].terminal = true;
+} // insert
+
+// ----------------------------------------------------------------------------
+
+uint32_t IgnoreMatcher::Set::child(std::vector<Node> const& trie, uint32_t node,
+                                   unsigned char c)
+{
+    std::vector<std::pair<unsigned char, uint32_t> > const& children = trie[node].children;
+    for (size_t i = 0; i < children.size(); ++i) {
+        if (children[i].first == c)
+            return children[i].second;
+    }
+    return 0; // the root is never a child
+} // child
+
+// ----------------------------------------------------------------------------
+
+bool IgnoreMatcher::Set::matches(std::string const& s, size_t firstSlash,
+                                 size_t lastSlash) const
+{
+    if (!literals.empty() && literals.find(s) != literals.end())
+        return true;
+    if (hasPrefixes) {
+        // "prefix*", the star matching the remaining characters
+        uint32_t node = 0;
+        for (size_t i = 0; ; ++i) {
+            if (prefixes[node].terminal && i >= lastSlash)
+                return true;
+            if (i == s.size())
+                break;
+            node = child(prefixes, node, static_cast<unsigned char>(s[i]));
+            if (node == 0)
+                break;
+        }
+    }
+    if (hasSuffixes) {
+        // "*suffix", the star matching the first characters
+        uint32_t node = 0;
+        for (size_t i = s.size(); ; --i) {
+            if (suffixes[node].terminal && i <= firstSlash)
+                return true;
+            if (i == 0)
+                break;
+            node = child(suffixes, node, static_cast<unsigned char>(s[i - 1]));
+            if (node == 0)
+                break;
+        }
+    }
+    if (hasGlobs) {
+        std::vector<std::string> const* candidates[2] = {
+            &globs[static_cast<unsigned char>(s.c_str()[0])], &globs[anyFirst]
+        };
+        for (size_t c = 0; c < 2; ++c) {
+            for (size_t i = 0; i < candidates[c]->size(); ++i) {
+                if (fnmatch((*candidates[c])[i].c_str(), s.c_str(), FNM_PATHNAME) == 0)
+                    return true;
+            }
+        }
+    }
+    return false;
+} // matches
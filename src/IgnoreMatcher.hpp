@@ -0,0 +1,111 @@
+// IgnoreMatcher.hpp
+//
+// ----------------------------------------------------------------------------
+//
+// Copyright (C) 2021  Jean-Marc Bourguet
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//   * Redistributions of source code must retain the above copyright
+//     notice, this list of conditions and the following disclaimer.
+//
+//   * Redistributions in binary form must reproduce the above copyright
+//     notice, this list of conditions and the following disclaimer in the
+//     documentation and/or other materials provided with the distribution.
+//
+//   * Neither the name of Jean-Marc Bourguet nor the names of other
+//     contributors may be used to endorse or promote products derived from
+//     this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+// IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+// TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+// PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+// TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+// NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+// ----------------------------------------------------------------------------
+//
+// The patterns of the ignored directories, compiled so that checking an
+// entry doesn't depend much on their number.  They have the fnmatch
+// semantics with FNM_PATHNAME, matching either the name or the full path of
+// the entry.  As neither a wildcard nor a bracket expression matches a '/',
+// a pattern with a '/' out of brackets can only match the path and one
+// without can only match the name.  Literal
+// patterns are kept in hash sets, "literal*" and "*literal" ones in tries
+// of prefixes and of reversed suffixes, and the others, for fnmatch, are
+// indexed by their first character when it is literal.
+//
+// ----------------------------------------------------------------------------
+
+#ifndef IGNORE_MATCHER_HPP
+#define IGNORE_MATCHER_HPP
+
+#include <stdint.h>
+#include <string>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+// ----------------------------------------------------------------------------
+// IgnoreMatcher
+// ----------------------------------------------------------------------------
+
+class IgnoreMatcher
+{
+public:
+    IgnoreMatcher();
+
+    void add(std::string const& pattern);
+    bool empty() const;
+
+    /// whether a pattern matches the entry name of path
+    bool matches(std::string const& name, std::string const& path) const;
+private:
+    /// patterns matched against either the names or the paths
+    struct Set
+    {
+        Set();
+
+        void add(std::string const& pattern);
+        /// wildcards are not allowed to match before firstSlash (the
+        /// position of the first '/' of s, or its size) and after lastSlash
+        /// (the position of its last '/' plus one, or 0)
+        bool matches(std::string const& s, size_t firstSlash, size_t lastSlash) const;
+
+        struct Node
+        {
+            Node() : terminal(false) {}
+            bool terminal;
+            std::vector<std::pair<unsigned char, uint32_t> > children;
+        };
+
+        static void insert(std::vector<Node>& trie, std::string const& key, bool reversed);
+        static uint32_t child(std::vector<Node> const& trie, uint32_t node, unsigned char c);
+
+        std::unordered_set<std::string> literals;
+        std::vector<Node> prefixes;
+        std::vector<Node> suffixes;
+        std::vector<std::vector<std::string> > globs; // by first character, 256 for any
+        bool hasPrefixes;
+        bool hasSuffixes;
+        bool hasGlobs;
+    };
+
+    Set myNamePatterns;
+    Set myPathPatterns;
+    bool myEmpty;
+}; // IgnoreMatcher
+
+// ----------------------------------------------------------------------------
+
+#endif
@@ -0,0 +1,151 @@
+// InodeSet.cpp
+//
+// ----------------------------------------------------------------------------
+//
+// Copyright (C) 2021  Jean-Marc Bourguet
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//   * Redistributions of source code must retain the above copyright
+//     notice, this list of conditions and the following disclaimer.
+//
+//   * Redistributions in binary form must reproduce the above copyright
+//     notice, this list of conditions and the following disclaimer in the
+//     documentation and/or other materials provided with the distribution.
+//
+//   * Neither the name of Jean-Marc Bourguet nor the names of other
+//     contributors may be used to endorse or promote products derived from
+//     this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+// IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+// TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+// PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+// TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+// NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// ----------------------------------------------------------------------------
+
+#include "InodeSet.hpp"
+
+namespace
+{
+
+size_t const initialSize = 64; // per shard, a power of 2
+
+uint64_t hashOf(uint64_t device, uint64_t inode)
+{
+    // the finalizer of MurmurHash3
+    uint64_t h = inode ^ (device * 0x9E3779B97F4A7C15ULL);
+    h ^= h >> 33;
+    h *= 0xFF51AFD7ED558CCDULL;
+    h ^= h >> 33;
+    h *= 0xC4CEB9FE1A85EC53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+}
+
+// ----------------------------------------------------------------------------
+
+InodeSet::InodeSet(size_t maxEntries)
+    : myMaxPerShard(maxEntries / shardCount + 1)
+{
+} // InodeSet
+
+// ----------------------------------------------------------------------------
+
+void InodeSet::place(std::vector<Key>& table, Key const& key, uint64_t hash)
+{
+    size_t const mask = table.size() - 1;
+    size_t i = hash & mask;
+    while (table[i].inode != 0 || table[i].device != 0) {
+        i = (i + 1) & mask;
+    }
+    table[i] = key;
+} // place
+
+// ----------------------------------------------------------------------------
+
+bool InodeSet::insert(dev_t device, ino_t inode)
+{
+    Key key;
+    key.device = device;
+    key.inode = inode;
+    uint64_t const hash = hashOf(key.device, key.inode);
+    Shard& shard = myShards[hash >> (64 - shardBits)];
+    std::lock_guard<std::mutex> lock(shard.mutex);
+
+    if (shard.table.empty())
+        shard.table.resize(initialSize);
+    size_t const mask = shard.table.size() - 1;
+    for (size_t i = hash & mask; ; i = (i + 1) & mask) {
+        Key const& k = shard.table[i];
+        if (k.inode == key.inode && k.device == key.device)
+            return false;
+        if (k.inode == 0 && k.device == 0)
+            break;
+    }
+
+    if (shard.count >= myMaxPerShard) {
+        ++shard.dropped;
+        return true;
+    }
+    if ((shard.count + 1) * 4 > shard.table.size() * 3) {
+        std::vector<Key> bigger(shard.table.size() * 2);
+        for (size_t i = 0; i < shard.table.size(); ++i) {
+            Key const& k = shard.table[i];
+            if (k.inode != 0 || k.device != 0)
+                place(bigger, k, hashOf(k.device, k.inode));
+        }
+        shard.table.swap(bigger);
+    }
+    place(shard.table, key, hash);
+    ++shard.count;
+    return true;
+} // insert
+
+// ----------------------------------------------------------------------------
+
+size_t InodeSet::count() const
+{
+    size_t result = 0;
+    for (unsigned i = 0; i < shardCount; ++i) {
+        std::lock_guard<std::mutex> lock(myShards[i].mutex);
+        result += myShards[i].count;
+    }
+    return result;
+} // count
+
+// ----------------------------------------------------------------------------
+
+size_t InodeSet::dropped() const
+{
+    size_t result = 0;
+    for (unsigned i = 0; i < shardCount; ++i) {
+        std::lock_guard<std::mutex> lock(myShards[i].mutex);
+        result += myShards[i].dropped;
+    }
+    return result;
+} // dropped
+
+// ----------------------------------------------------------------------------
+
+size_t InodeSet::memoryUsed() const
+{
+    size_t result = 0;
+    for (unsigned i = 0; i < shardCount; ++i) {
+        std::lock_guard<std::mutex> lock(myShards[i].mutex);
+        result += myShards[i].table.capacity() * sizeof(Key);
+    }
+    return result;
+} // memoryUsed
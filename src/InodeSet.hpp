@@ -0,0 +1,104 @@
+// InodeSet.hpp
+//
+// ----------------------------------------------------------------------------
+//
+// Copyright (C) 2021  Jean-Marc Bourguet
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//   * Redistributions of source code must retain the above copyright
+//     notice, this list of conditions and the following disclaimer.
+//
+//   * Redistributions in binary form must reproduce the above copyright
+//     notice, this list of conditions and the following disclaimer in the
+//     documentation and/or other materials provided with the distribution.
+//
+//   * Neither the name of Jean-Marc Bourguet nor the names of other
+//     contributors may be used to endorse or promote products derived from
+//     this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+// IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+// TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+// PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+// TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+// NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+// ----------------------------------------------------------------------------
+//
+//
+// Set of (device, inode) pairs shared by the scanning threads, used to
+// count only once the files having several hard links.  It is split in
+// shards with their own lock and open addressing table, so that threads
+// rarely contend.  The number of entries is bounded: once the limit is
+// reached, new inodes are no more recorded (and are thus counted each time
+// they are seen); dropped() tells how many.
+//
+// ----------------------------------------------------------------------------
+
+#ifndef INODE_SET_HPP
+#define INODE_SET_HPP
+
+#include <mutex>
+#include <stdint.h>
+#include <sys/types.h>
+#include <vector>
+
+// ----------------------------------------------------------------------------
+// InodeSet
+// ----------------------------------------------------------------------------
+
+class InodeSet
+{
+public:
+    explicit InodeSet(size_t maxEntries);
+
+    /// true if (device, inode) was not already in the set
+    bool insert(dev_t device, ino_t inode);
+
+    size_t count() const;
+    size_t dropped() const;
+    /// bytes allocated for the tables
+    size_t memoryUsed() const;
+private: // and not implemented
+    InodeSet(InodeSet const&);
+    InodeSet& operator=(InodeSet const&);
+
+private:
+    struct Key
+    {
+        uint64_t device;
+        uint64_t inode;
+    };
+
+    struct Shard
+    {
+        Shard() : count(0), dropped(0) {}
+
+        mutable std::mutex mutex;
+        std::vector<Key> table;
+        size_t count;
+        size_t dropped;
+    };
+
+    static unsigned const shardBits = 6;
+    static unsigned const shardCount = 1U << shardBits;
+
+    static void place(std::vector<Key>& table, Key const& key, uint64_t hash);
+
+    Shard myShards[shardCount];
+    size_t myMaxPerShard;
+}; // InodeSet
+
+// ----------------------------------------------------------------------------
+
+#endif
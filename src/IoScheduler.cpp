@@ -0,0 +1,282 @@
+// IoScheduler.cpp
+//
+// ----------------------------------------------------------------------------
+//
+// Copyright (C) 2021  Jean-Marc Bourguet
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//   * Redistributions of source code must retain the above copyright
+//     notice, this list of conditions and the following disclaimer.
+//
+//   * Redistributions in binary form must reproduce the above copyright
+//     notice, this list of conditions and the following disclaimer in the
+//     documentation and/or other materials provided with the distribution.
+//
+//   * Neither the name of Jean-Marc Bourguet nor the names of other
+//     contributors may be used to endorse or promote products derived from
+//     this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+// IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+// TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+// PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+// TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+// NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// ----------------------------------------------------------------------------
+
+#include "IoScheduler.hpp"
+
+#include <algorithm>
+#include <thread>
+
+#ifdef __linux__
+#include <sys/vfs.h>
+#endif
+
+namespace
+{
+
+/// the first limit of a network file system, and the lowest one
+size_t const firstNetworkLimit = 8;
+size_t const lowestNetworkLimit = 2;
+/// reads to measure before adapting the limit again, per directory allowed
+size_t const samplesPerRound = 4;
+
+/// statfs f_type values
+struct FileSystem
+{
+    uint32_t type;
+    IoScheduler::Kind kind;
+};
+
+FileSystem const theFileSystems[] = {
+    { 0x6969U, IoScheduler::networkKind },       // nfs
+    { 0x517BU, IoScheduler::networkKind },       // smb
+    { 0xFF534D42U, IoScheduler::networkKind },   // cifs
+    { 0xFE534D42U, IoScheduler::networkKind },   // smb2
+    { 0x00C36400U, IoScheduler::networkKind },   // ceph
+    { 0x01021997U, IoScheduler::networkKind },   // 9p
+    { 0x5346414FU, IoScheduler::networkKind },   // afs
+    { 0x6B414653U, IoScheduler::networkKind },   // kafs
+    { 0x73757245U, IoScheduler::networkKind },   // coda
+    { 0x0BD00BD0U, IoScheduler::networkKind },   // lustre
+    { 0x47504653U, IoScheduler::networkKind },   // gpfs
+    { 0x65735546U, IoScheduler::networkKind },   // fuse (sshfs, glusterfs, ...)
+    { 0x01021994U, IoScheduler::memoryKind },    // tmpfs
+    { 0x858458F6U, IoScheduler::memoryKind },    // ramfs
+    { 0x9FA0U, IoScheduler::memoryKind },        // proc
+    { 0x62656572U, IoScheduler::memoryKind },    // sysfs
+    { 0x1CD1U, IoScheduler::memoryKind },        // devpts
+    { 0x63677270U, IoScheduler::memoryKind }     // cgroup2
+};
+
+}
+
+// ----------------------------------------------------------------------------
+
+struct IoScheduler::Device
+{
+    Kind kind;
+    size_t limit;
+    size_t active;
+    bool saturated; // the limit has been reached during the round
+    size_t samples; // during the round
+    long long average; // ns by operation, moving average
+    long long best; // lowest average seen, slowly forgotten
+}; // Device
+
+// ----------------------------------------------------------------------------
+
+IoScheduler::IoScheduler(size_t threads)
+    : myThreads(threads == 0 ? 1 : threads),
+      myLocalLimit(std::thread::hardware_concurrency()),
+      myWaits(0),
+      myLowestLimit(0),
+      myHighestLimit(0)
+{
+    if (myLocalLimit == 0 || myLocalLimit > myThreads)
+        myLocalLimit = myThreads;
+} // IoScheduler
+
+// ----------------------------------------------------------------------------
+
+IoScheduler::~IoScheduler()
+{
+    for (std::unordered_map<uint64_t, Device*>::iterator i = myDevices.begin(),
+             end = myDevices.end(); i != end; ++i)
+    {
+        delete i->second;
+    }
+} // ~IoScheduler
+
+// ----------------------------------------------------------------------------
+
+IoScheduler::Kind IoScheduler::learn(uint64_t device, int fd)
+{
+    {
+        std::lock_guard<std::mutex> lock(myMutex);
+        std::unordered_map<uint64_t, Device*>::const_iterator found = myDevices.find(device);
+        if (found != myDevices.end())
+            return found->second->kind;
+    }
+    Kind const kind = kindOf(fd);
+    Device* created = new Device;
+    created->kind = kind;
+    created->limit = kind == networkKind ? std::min(firstNetworkLimit, myThreads) : myLocalLimit;
+    created->active = 0;
+    created->saturated = false;
+    created->samples = 0;
+    created->average = 0;
+    created->best = 0;
+    std::lock_guard<std::mutex> lock(myMutex);
+    std::pair<std::unordered_map<uint64_t, Device*>::iterator, bool> inserted
+        = myDevices.insert(std::make_pair(device, created));
+    if (!inserted.second) {
+        // learnt meanwhile by another thread
+        delete created;
+    } else if (kind == networkKind) {
+        if (myLowestLimit == 0 || created->limit < myLowestLimit)
+            myLowestLimit = created->limit;
+        if (created->limit > myHighestLimit)
+            myHighestLimit = created->limit;
+    }
+    return inserted.first->second->kind;
+} // learn
+
+// ----------------------------------------------------------------------------
+
+bool IoScheduler::acquire(uint64_t device)
+{
+    std::unique_lock<std::mutex> lock(myMutex);
+    std::unordered_map<uint64_t, Device*>::const_iterator found = myDevices.find(device);
+    if (found == myDevices.end())
+        return false;
+    Device& current = *found->second;
+    if (current.active >= current.limit) {
+        ++myWaits;
+        while (current.active >= current.limit) {
+            myCondition.wait(lock);
+        }
+    }
+    ++current.active;
+    if (current.active == current.limit)
+        current.saturated = true;
+    return true;
+} // acquire
+
+// ----------------------------------------------------------------------------
+
+void IoScheduler::release(uint64_t device, size_t operations, long long nanoseconds)
+{
+    {
+        std::lock_guard<std::mutex> lock(myMutex);
+        Device& current = *myDevices[device];
+        --current.active;
+        if (current.kind == networkKind) {
+            long long const sample
+                = nanoseconds / static_cast<long long>(operations == 0 ? 1 : operations);
+            current.average = current.samples == 0 && current.best == 0
+                ? sample
+                : current.average + (sample - current.average) / 8;
+            if (++current.samples >= samplesPerRound * current.limit)
+                adapt(current);
+        }
+    }
+    // the waiting threads may be for several devices
+    myCondition.notify_all();
+} // release
+
+// ----------------------------------------------------------------------------
+
+size_t IoScheduler::networkDevices() const
+{
+    std::lock_guard<std::mutex> lock(myMutex);
+    size_t result = 0;
+    for (std::unordered_map<uint64_t, Device*>::const_iterator i = myDevices.begin(),
+             end = myDevices.end(); i != end; ++i)
+    {
+        if (i->second->kind == networkKind)
+            ++result;
+    }
+    return result;
+} // networkDevices
+
+// ----------------------------------------------------------------------------
+
+size_t IoScheduler::waits() const
+{
+    std::lock_guard<std::mutex> lock(myMutex);
+    return myWaits;
+} // waits
+
+// ----------------------------------------------------------------------------
+
+size_t IoScheduler::lowestLimit() const
+{
+    std::lock_guard<std::mutex> lock(myMutex);
+    return myLowestLimit;
+} // lowestLimit
+
+// ----------------------------------------------------------------------------
+
+size_t IoScheduler::highestLimit() const
+{
+    std::lock_guard<std::mutex> lock(myMutex);
+    return myHighestLimit;
+} // highestLimit
+
+// ----------------------------------------------------------------------------
+
+IoScheduler::Kind IoScheduler::kindOf(int fd)
+{
+#ifdef __linux__
+    struct statfs buf;
+    if (fstatfs(fd, &buf) != 0)
+        return diskKind;
+    // f_type is signed on some architectures, the magic numbers aren't
+    uint32_t const type = static_cast<uint32_t>(buf.f_type);
+    for (size_t i = 0; i < sizeof theFileSystems / sizeof theFileSystems[0]; ++i) {
+        if (theFileSystems[i].type == type)
+            return theFileSystems[i].kind;
+    }
+#else
+    (void)fd;
+#endif
+    return diskKind;
+} // kindOf
+
+// ----------------------------------------------------------------------------
+
+void IoScheduler::adapt(Device& device)
+{
+    // the best is forgotten slowly, so that a few fast reads (cached
+    // entries) don't keep the limit low for ever
+    if (device.best == 0 || device.average < device.best) {
+        device.best = device.average;
+    } else {
+        device.best += device.best / 64;
+    }
+    if (device.average > 3 * device.best) {
+        device.limit = std::max(lowestNetworkLimit, device.limit - device.limit / 4);
+    } else if (device.saturated && 2 * device.average <= 3 * device.best
+               && device.limit < myThreads)
+    {
+        ++device.limit;
+    }
+    device.samples = 0;
+    device.saturated = device.active >= device.limit;
+    if (device.limit < myLowestLimit)
+        myLowestLimit = device.limit;
+    if (device.limit > myHighestLimit)
+        myHighestLimit = device.limit;
+} // adapt
@@ -0,0 +1,116 @@
+// IoScheduler.hpp
+//
+// ----------------------------------------------------------------------------
+//
+// Copyright (C) 2021  Jean-Marc Bourguet
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//   * Redistributions of source code must retain the above copyright
+//     notice, this list of conditions and the following disclaimer.
+//
+//   * Redistributions in binary form must reproduce the above copyright
+//     notice, this list of conditions and the following disclaimer in the
+//     documentation and/or other materials provided with the distribution.
+//
+//   * Neither the name of Jean-Marc Bourguet nor the names of other
+//     contributors may be used to endorse or promote products derived from
+//     this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+// IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+// TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+// PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+// TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+// NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+// ----------------------------------------------------------------------------
+//
+//
+// Limit the number of directories read at the same time on each file
+// system, according to its kind and, for the network ones, to the latency
+// measured while scanning.
+//
+// The kind of a file system is found with fstatfs the first time one of its
+// directories is read; the directories of a file system not known yet are
+// not limited.  Local file systems are read by as many threads as there are
+// processors.  Network ones (NFS, CephFS, SMB, ...) are latency bound: each
+// operation is a round trip, and more directories must be read concurrently
+// to keep the link busy.  They start with a few and adapt like a congestion
+// window: while the time per operation stays close to the best seen and the
+// limit is reached, it grows by one; when that time rises well above, the
+// server or the link is saturated and the limit shrinks by a quarter.
+//
+// ----------------------------------------------------------------------------
+
+#ifndef IO_SCHEDULER_HPP
+#define IO_SCHEDULER_HPP
+
+#include <condition_variable>
+#include <mutex>
+#include <stddef.h>
+#include <stdint.h>
+#include <unordered_map>
+
+// ----------------------------------------------------------------------------
+// IoScheduler
+// ----------------------------------------------------------------------------
+
+class IoScheduler
+{
+public:
+    enum Kind { diskKind, memoryKind, networkKind };
+
+    /// threads is the number of scanning threads, the highest limit
+    explicit IoScheduler(size_t threads);
+    ~IoScheduler();
+
+    /// Find the kind of device, of which fd is a directory, if it isn't
+    /// known yet; returns it.
+    Kind learn(uint64_t device, int fd);
+    /// Wait until a directory of device may be read; returns false if device
+    /// isn't known, and then release must not be called.
+    bool acquire(uint64_t device);
+    /// A read allowed by acquire is done, operations system calls having
+    /// taken nanoseconds.
+    void release(uint64_t device, size_t operations, long long nanoseconds);
+
+    /// network file systems met
+    size_t networkDevices() const;
+    /// times a thread has waited for the limit of its file system
+    size_t waits() const;
+    /// the lowest and highest limits of the network file systems
+    size_t lowestLimit() const;
+    size_t highestLimit() const;
+private: // and not implemented
+    IoScheduler(IoScheduler const&);
+    IoScheduler& operator=(IoScheduler const&);
+
+private:
+    struct Device;
+
+    static Kind kindOf(int fd);
+    void adapt(Device& device);
+
+    mutable std::mutex myMutex;
+    std::condition_variable myCondition;
+    std::unordered_map<uint64_t, Device*> myDevices;
+    size_t myThreads;
+    size_t myLocalLimit;
+    size_t myWaits;
+    size_t myLowestLimit;
+    size_t myHighestLimit;
+}; // IoScheduler
+
+// ----------------------------------------------------------------------------
+
+#endif
@@ -0,0 +1,139 @@
+// Progress.cpp
+//
+// ----------------------------------------------------------------------------
+//
+// Copyright (C) 2021  Jean-Marc Bourguet
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//   * Redistributions of source code must retain the above copyright
+//     notice, this list of conditions and the following disclaimer.
+//
+//   * Redistributions in binary form must reproduce the above copyright
+//     notice, this list of conditions and the following disclaimer in the
+//     documentation and/or other materials provided with the distribution.
+//
+//   * Neither the name of Jean-Marc Bourguet nor the names of other
+//     contributors may be used to endorse or promote products derived from
+//     this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+// IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+// TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+// PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+// TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+// NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// ----------------------------------------------------------------------------
+
+#include "Progress.hpp"
+
+#include <sstream>
+#include <string>
+
+#include "info.hpp"
+
+namespace
+{
+
+std::chrono::milliseconds const period(100);
+size_t const maxPathLength = 60;
+
+}
+
+// ----------------------------------------------------------------------------
+
+Progress::Progress(DirTree const& tree)
+    : myTree(&tree),
+      myStart(std::chrono::steady_clock::now()),
+      myDirectories(0),
+      myEntries(0),
+      mySize(0),
+      myStopped(false),
+      myThread(&Progress::run, this)
+{
+} // Progress
+
+// ----------------------------------------------------------------------------
+
+Progress::~Progress()
+{
+    {
+        std::lock_guard<std::mutex> lock(myMutex);
+        myStopped = true;
+    }
+    myCondition.notify_all();
+    myThread.join();
+    message("");
+} // ~Progress
+
+// ----------------------------------------------------------------------------
+
+void Progress::enter(DirTree const&, DirTree::Index, std::string const& path)
+{
+    // another thread is already telling what is being read
+    std::unique_lock<std::mutex> lock(myCurrentMutex, std::try_to_lock);
+    if (lock)
+        myCurrent = path;
+} // enter
+
+// ----------------------------------------------------------------------------
+
+void Progress::read(size_t entries, size_t size)
+{
+    myDirectories.fetch_add(1, std::memory_order_relaxed);
+    myEntries.fetch_add(entries, std::memory_order_relaxed);
+    mySize.fetch_add(size, std::memory_order_relaxed);
+} // read
+
+// ----------------------------------------------------------------------------
+
+void Progress::run()
+{
+    std::unique_lock<std::mutex> lock(myMutex);
+    std::chrono::steady_clock::time_point next = myStart + period;
+    while (!myStopped) {
+        if (myCondition.wait_until(lock, next) == std::cv_status::timeout) {
+            draw();
+            next += period;
+        }
+    }
+} // run
+
+// ----------------------------------------------------------------------------
+
+void Progress::draw()
+{
+    std::string path;
+    {
+        std::lock_guard<std::mutex> lock(myCurrentMutex);
+        path = myCurrent;
+    }
+    if (path.empty())
+        return;
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now()
+                                                   - myStart).count();
+    if (seconds <= 0)
+        seconds = 1e-3;
+    size_t const directories = myDirectories.load(std::memory_order_relaxed);
+    size_t const entries = myEntries.load(std::memory_order_relaxed);
+
+    if (path.size() > maxPathLength)
+        path = "..." + path.substr(path.size() - maxPathLength + 3);
+
+    std::ostringstream os;
+    os << directories << " dirs (" << size_t(double(directories) / seconds) << "/s), "
+       << entries << " entries (" << size_t(double(entries) / seconds) << "/s), "
+       << "size: " << format(displaySize(mySize.load(std::memory_order_relaxed),
+                                              myTree->isLogical()))
+       << "; reading " << path;
+    message(os.str());
+} // draw
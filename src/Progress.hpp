@@ -0,0 +1,104 @@
+// Progress.hpp
+//
+// ----------------------------------------------------------------------------
+//
+// Copyright (C) 2021  Jean-Marc Bourguet
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//   * Redistributions of source code must retain the above copyright
+//     notice, this list of conditions and the following disclaimer.
+//
+//   * Redistributions in binary form must reproduce the above copyright
+//     notice, this list of conditions and the following disclaimer in the
+//     documentation and/or other materials provided with the distribution.
+//
+//   * Neither the name of Jean-Marc Bourguet nor the names of other
+//     contributors may be used to endorse or promote products derived from
+//     this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+// IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+// TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+// PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+// TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+// NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+// ----------------------------------------------------------------------------
+//
+// Progress report of a scan.  The scanning threads only update atomic
+// counters and, unless another thread is doing it, the path being read; a
+// thread of its own redraws the status line, at most every 100 ms:
+// directories and entries (with their rate), bytes seen and the directory
+// being read.  It is given to the Scanner as its ScanVisitor.
+//
+// ----------------------------------------------------------------------------
+
+#ifndef PROGRESS_HPP
+#define PROGRESS_HPP
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <stddef.h>
+#include <string>
+#include <thread>
+
+#include "DirTree.hpp"
+#include "ScanVisitor.hpp"
+
+// ----------------------------------------------------------------------------
+// Progress
+// ----------------------------------------------------------------------------
+
+class Progress
+    : public ScanVisitor
+{
+public:
+    /// Start showing the progress of the scan building tree.
+    explicit Progress(DirTree const& tree);
+    /// Stop and clear the status line.
+    ~Progress();
+
+    /// node is being read
+    virtual void enter(DirTree const& tree, DirTree::Index node, std::string const& path);
+    /// a directory has been read, with entries entries of size (in the
+    /// unit of the tree)
+    virtual void read(size_t entries, size_t size);
+private: // and not implemented
+    Progress(Progress const&);
+    Progress& operator=(Progress const&);
+
+private:
+    void run();
+    void draw();
+
+    DirTree const* myTree;
+    std::chrono::steady_clock::time_point myStart;
+    std::atomic<size_t> myDirectories;
+    std::atomic<size_t> myEntries;
+    std::atomic<size_t> mySize;
+    /// the path of the directory being read, as the nodes and their names
+    /// may be reused (see ScanOptions::foldBelow) while the status line is
+    /// drawn
+    std::string myCurrent;
+    std::mutex myCurrentMutex;
+    bool myStopped;
+    std::mutex myMutex;
+    std::condition_variable myCondition;
+    std::thread myThread;
+}; // Progress
+
+// ----------------------------------------------------------------------------
+
+#endif
@@ -0,0 +1,358 @@
+// RecordWriter.cpp
+//
+// ----------------------------------------------------------------------------
+//
+// Copyright (C) 2021  Jean-Marc Bourguet
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//   * Redistributions of source code must retain the above copyright
+//     notice, this list of conditions and the following disclaimer.
+//
+//   * Redistributions in binary form must reproduce the above copyright
+//     notice, this list of conditions and the following disclaimer in the
+//     documentation and/or other materials provided with the distribution.
+//
+//   * Neither the name of Jean-Marc Bourguet nor the names of other
+//     contributors may be used to endorse or promote products derived from
+//     this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+// IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+// TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+// PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+// TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+// NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// ----------------------------------------------------------------------------
+
+#include "RecordWriter.hpp"
+
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+#include "DirInfo.hpp"
+#include "info.hpp"
+
+namespace
+{
+
+/// Append n in decimal, whatever the locale
+void appendDecimal(std::string& out, unsigned long long n)
+{
+    char digits[24];
+    size_t count = 0;
+    do {
+        digits[count++] = char('0' + n % 10);
+        n /= 10;
+    } while (n != 0);
+    while (count > 0) {
+        out += digits[--count];
+    }
+}
+
+/// The length of the UTF-8 sequence starting at s, or 0 if it is invalid
+/// (overlong, a surrogate or beyond U+10FFFF included)
+size_t utf8Length(unsigned char const* s)
+{
+    size_t length;
+    unsigned char low = 0x80;
+    unsigned char high = 0xBF;
+    if (s[0] < 0x80) {
+        return 1;
+    } else if (s[0] >= 0xC2 && s[0] <= 0xDF) {
+        length = 2;
+    } else if (s[0] >= 0xE0 && s[0] <= 0xEF) {
+        length = 3;
+        if (s[0] == 0xE0)
+            low = 0xA0;
+        else if (s[0] == 0xED)
+            high = 0x9F;
+    } else if (s[0] >= 0xF0 && s[0] <= 0xF4) {
+        length = 4;
+        if (s[0] == 0xF0)
+            low = 0x90;
+        else if (s[0] == 0xF4)
+            high = 0x8F;
+    } else {
+        return 0;
+    }
+    if (s[1] < low || s[1] > high)
+        return 0;
+    for (size_t i = 2; i < length; ++i) {
+        if (s[i] < 0x80 || s[i] > 0xBF)
+            return 0; // the terminating NUL stops there too
+    }
+    return length;
+}
+
+}
+
+// ----------------------------------------------------------------------------
+
+RecordWriter::RecordWriter(std::ostream& os, Format format, size_t minSize, size_t minDepth,
+                           bool histograms)
+    : myOS(&os),
+      myFormat(format),
+      myMinSize(minSize),
+      myMinDepth(minDepth),
+      myHistograms(histograms)
+{
+    if (myFormat == csv)
+        *myOS << "path,depth,size,direct_size,logical_size,physical_size,files,"
+                 "direct_files,incomplete" << (myHistograms ? ",sizes,types,ages" : "")
+              << "\r\n";
+} // RecordWriter
+
+// ----------------------------------------------------------------------------
+
+RecordWriter::~RecordWriter()
+{
+    myOS->flush();
+} // ~RecordWriter
+
+// ----------------------------------------------------------------------------
+
+void RecordWriter::write(DirTree const& tree, DirTree::Index node)
+{
+    if (tree.isContent(node))
+        return;
+    size_t depth = 0;
+    for (DirTree::Index i = tree.parent(node); i != DirTree::none; i = tree.parent(i)) {
+        ++depth;
+    }
+    size_t const size = displaySize(tree.size(node), tree.isLogical());
+    if (depth > myMinDepth && size < myMinSize)
+        return;
+    size_t const directSize = displaySize(tree.directSize(node), tree.isLogical());
+    DirInfo const info(&tree, node);
+    size_t const logicalSize = info.logicalSize();
+    size_t const physicalSize = info.physicalSize();
+    size_t const files = tree.files(node);
+    size_t const directFiles = tree.directFiles(node);
+    bool const incomplete = tree.isIncomplete(node);
+    Histogram const empty;
+    Histogram const& histogram
+        = tree.histogram(node) != NULL ? *tree.histogram(node) : empty;
+
+    std::lock_guard<std::mutex> lock(myMutex);
+    myRecord.clear();
+    switch (myFormat) {
+    case jsonLines:
+        myRecord += "{\"path\":\"";
+        appendPath(tree, node);
+        myRecord += "\",\"depth\":";
+        appendDecimal(myRecord, depth);
+        myRecord += ",\"size\":";
+        appendDecimal(myRecord, size);
+        myRecord += ",\"direct_size\":";
+        appendDecimal(myRecord, directSize);
+        myRecord += ",\"logical_size\":";
+        appendDecimal(myRecord, logicalSize);
+        myRecord += ",\"physical_size\":";
+        appendDecimal(myRecord, physicalSize);
+        myRecord += ",\"files\":";
+        appendDecimal(myRecord, files);
+        myRecord += ",\"direct_files\":";
+        appendDecimal(myRecord, directFiles);
+        myRecord += incomplete ? ",\"incomplete\":true" : ",\"incomplete\":false";
+        if (myHistograms) {
+            appendHistogram(histogram, Histogram::bySize, tree.isLogical());
+            appendHistogram(histogram, Histogram::byType, tree.isLogical());
+            appendHistogram(histogram, Histogram::byAge, tree.isLogical());
+        }
+        myRecord += "}\n";
+        break;
+    case csv:
+        myRecord += '"';
+        appendPath(tree, node);
+        myRecord += "\",";
+        appendDecimal(myRecord, depth);
+        myRecord += ',';
+        appendDecimal(myRecord, size);
+        myRecord += ',';
+        appendDecimal(myRecord, directSize);
+        myRecord += ',';
+        appendDecimal(myRecord, logicalSize);
+        myRecord += ',';
+        appendDecimal(myRecord, physicalSize);
+        myRecord += ',';
+        appendDecimal(myRecord, files);
+        myRecord += ',';
+        appendDecimal(myRecord, directFiles);
+        myRecord += incomplete ? ",1" : ",0";
+        if (myHistograms) {
+            appendHistogram(histogram, Histogram::bySize, tree.isLogical());
+            appendHistogram(histogram, Histogram::byType, tree.isLogical());
+            appendHistogram(histogram, Histogram::byAge, tree.isLogical());
+        }
+        myRecord += "\r\n";
+        break;
+    case nulSeparated:
+        appendDecimal(myRecord, size);
+        myRecord += '\t';
+        appendDecimal(myRecord, directSize);
+        myRecord += '\t';
+        appendDecimal(myRecord, logicalSize);
+        myRecord += '\t';
+        appendDecimal(myRecord, physicalSize);
+        myRecord += '\t';
+        appendDecimal(myRecord, files);
+        myRecord += '\t';
+        appendDecimal(myRecord, directFiles);
+        myRecord += '\t';
+        appendDecimal(myRecord, depth);
+        myRecord += incomplete ? "\t1" : "\t0";
+        if (myHistograms) {
+            appendHistogram(histogram, Histogram::bySize, tree.isLogical());
+            appendHistogram(histogram, Histogram::byType, tree.isLogical());
+            appendHistogram(histogram, Histogram::byAge, tree.isLogical());
+        }
+        myRecord += '\t';
+        appendPath(tree, node);
+        myRecord += '\0';
+        break;
+    }
+    myOS->write(myRecord.data(), std::streamsize(myRecord.size()));
+} // write
+
+// ----------------------------------------------------------------------------
+
+void RecordWriter::writeTree(DirTree const& tree, DirTree::Index root)
+{
+    // children first, as during a scan
+    std::vector<DirTree::Index> pending(1, root);
+    std::vector<DirTree::Index> order;
+    while (!pending.empty()) {
+        DirTree::Index const i = pending.back();
+        pending.pop_back();
+        order.push_back(i);
+        for (DirTree::Index c = tree.firstChild(i); c != DirTree::none; c = tree.nextSibling(c)) {
+            pending.push_back(c);
+        }
+    }
+    for (size_t i = order.size(); i > 0; --i) {
+        write(tree, order[i-1]);
+    }
+} // writeTree
+
+// ----------------------------------------------------------------------------
+
+void RecordWriter::finalized(DirTree const& tree, DirTree::Index node)
+{
+    write(tree, node);
+} // finalized
+
+// ----------------------------------------------------------------------------
+
+bool RecordWriter::parseFormat(std::string const& name, Format& format)
+{
+    if (name == "json") {
+        format = jsonLines;
+    } else if (name == "csv") {
+        format = csv;
+    } else if (name == "nul") {
+        format = nulSeparated;
+    } else {
+        return false;
+    }
+    return true;
+} // parseFormat
+
+// ----------------------------------------------------------------------------
+
+void RecordWriter::appendPath(DirTree const& tree, DirTree::Index node)
+{
+    DirTree::Index const parent = tree.parent(node);
+    if (parent != DirTree::none) {
+        appendPath(tree, parent);
+        char const* parentName = tree.name(parent);
+        if (parentName[0] == '\0' || parentName[strlen(parentName) - 1] != '/')
+            appendField("/");
+    }
+    appendField(tree.name(node));
+} // appendPath
+
+// ----------------------------------------------------------------------------
+
+void RecordWriter::appendField(char const* text)
+{
+    // The bytes of the names are kept, only what the format requires is
+    // escaped.  JSON strings must be UTF-8, so each byte of an invalid
+    // sequence is written as the code point of the same value.
+    for ( ; *text != '\0'; ++text) {
+        unsigned char const c = static_cast<unsigned char>(*text);
+        if (myFormat == jsonLines && c >= 0x80) {
+            size_t const length =
+                utf8Length(reinterpret_cast<unsigned char const*>(text));
+            if (length == 0) {
+                char escaped[8];
+                snprintf(escaped, sizeof escaped, "\\u%04x", c);
+                myRecord += escaped;
+            } else {
+                myRecord.append(text, length);
+                text += length - 1;
+            }
+        } else if (myFormat == jsonLines && (c == '"' || c == '\\')) {
+            myRecord += '\\';
+            myRecord += char(c);
+        } else if (myFormat == jsonLines && c < 0x20) {
+            char escaped[8];
+            snprintf(escaped, sizeof escaped, "\\u%04x", c);
+            myRecord += escaped;
+        } else if (myFormat == csv && c == '"') {
+            myRecord += "\"\"";
+        } else {
+            myRecord += char(c);
+        }
+    }
+} // appendField
+
+// ----------------------------------------------------------------------------
+
+void RecordWriter::appendHistogram(Histogram const& histogram, Histogram::Kind kind,
+                                   bool logical)
+{
+    // preceded by a separator, as the fields after the first one
+    switch (myFormat) {
+    case jsonLines:
+        myRecord += ",\"";
+        myRecord += Histogram::kindName(kind);
+        myRecord += "\":{";
+        break;
+    case csv:
+        myRecord += ',';
+        break;
+    case nulSeparated:
+        myRecord += '\t';
+        break;
+    }
+    for (size_t c = 0; c < Histogram::classCount(kind); ++c) {
+        if (myFormat == jsonLines) {
+            myRecord += c > 0 ? ",\"" : "\"";
+            myRecord += Histogram::className(kind, c);
+            myRecord += "\":[";
+            appendDecimal(myRecord, histogram.files(kind, c));
+            myRecord += ',';
+            appendDecimal(myRecord, displaySize(histogram.size(kind, c), logical));
+            myRecord += ']';
+        } else {
+            if (c > 0)
+                myRecord += ' ';
+            appendDecimal(myRecord, histogram.files(kind, c));
+            myRecord += ':';
+            appendDecimal(myRecord, displaySize(histogram.size(kind, c), logical));
+        }
+    }
+    if (myFormat == jsonLines)
+        myRecord += '}';
+} // appendHistogram
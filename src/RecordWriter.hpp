@@ -0,0 +1,110 @@
+// RecordWriter.hpp
+//
+// ----------------------------------------------------------------------------
+//
+// Copyright (C) 2021  Jean-Marc Bourguet
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//   * Redistributions of source code must retain the above copyright
+//     notice, this list of conditions and the following disclaimer.
+//
+//   * Redistributions in binary form must reproduce the above copyright
+//     notice, this list of conditions and the following disclaimer in the
+//     documentation and/or other materials provided with the distribution.
+//
+//   * Neither the name of Jean-Marc Bourguet nor the names of other
+//     contributors may be used to endorse or promote products derived from
+//     this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+// IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+// TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+// PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+// TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+// NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+// ----------------------------------------------------------------------------
+//
+// Machine readable output: one record per directory, written as soon as it
+// is finalized during the scan (the RecordWriter being the ScanVisitor of
+// the Scanner) so that a consumer can start before the end.  A record gives
+// the size (as chosen by -l), the direct size, both logical and physical
+// sizes and the file counts; sizes are raw byte counts and numbers don't
+// depend on the locale.  Records are available as JSON Lines, CSV (with a
+// header line) or tab separated fields ending with a NUL, the path being
+// the last field.  With the histograms, the files and bytes of each class
+// are added: as objects keyed by class in JSON, as a field per kind of
+// class listing files:bytes pairs separated by spaces otherwise.
+//
+// ----------------------------------------------------------------------------
+
+#ifndef RECORD_WRITER_HPP
+#define RECORD_WRITER_HPP
+
+#include <mutex>
+#include <ostream>
+#include <stddef.h>
+#include <string>
+
+#include "DirTree.hpp"
+#include "ScanVisitor.hpp"
+
+// ----------------------------------------------------------------------------
+// RecordWriter
+// ----------------------------------------------------------------------------
+
+class RecordWriter
+    : public ScanVisitor
+{
+public:
+    enum Format { jsonLines, csv, nulSeparated };
+
+    /// Write to os the records of the directories of at least minSize
+    /// bytes or at most minDepth levels under their root, with their
+    /// histograms if asked.
+    RecordWriter(std::ostream& os, Format format, size_t minSize, size_t minDepth,
+                 bool histograms);
+    ~RecordWriter();
+
+    /// Write the record of node, if selected; may be called by several
+    /// threads.
+    void write(DirTree const& tree, DirTree::Index node);
+    /// Write the records of the subtree rooted at root.
+    void writeTree(DirTree const& tree, DirTree::Index root);
+    /// write(tree, node)
+    virtual void finalized(DirTree const& tree, DirTree::Index node);
+
+    /// Parse the name of a format, return false if unknown.
+    static bool parseFormat(std::string const& name, Format& format);
+private: // and not implemented
+    RecordWriter(RecordWriter const&);
+    RecordWriter& operator=(RecordWriter const&);
+
+private:
+    void appendPath(DirTree const& tree, DirTree::Index node);
+    void appendField(char const* text);
+    /// logical tells the unit of the sizes of histogram
+    void appendHistogram(Histogram const& histogram, Histogram::Kind kind, bool logical);
+
+    std::ostream* myOS;
+    Format myFormat;
+    size_t myMinSize;
+    size_t myMinDepth;
+    bool myHistograms;
+    std::mutex myMutex;
+    std::string myRecord; // reused
+}; // RecordWriter
+
+// ----------------------------------------------------------------------------
+
+#endif
@@ -0,0 +1,76 @@
+// ScanVisitor.cpp
+//
+// ----------------------------------------------------------------------------
+//
+// Copyright (C) 2021  Jean-Marc Bourguet
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//   * Redistributions of source code must retain the above copyright
+//     notice, this list of conditions and the following disclaimer.
+//
+//   * Redistributions in binary form must reproduce the above copyright
+//     notice, this list of conditions and the following disclaimer in the
+//     documentation and/or other materials provided with the distribution.
+//
+//   * Neither the name of Jean-Marc Bourguet nor the names of other
+//     contributors may be used to endorse or promote products derived from
+//     this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+// IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+// TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+// PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+// TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+// NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// ----------------------------------------------------------------------------
+
+#include "ScanVisitor.hpp"
+
+#include "info.hpp"
+
+// ----------------------------------------------------------------------------
+
+ScanVisitor::ScanVisitor()
+{
+} // ScanVisitor
+
+// ----------------------------------------------------------------------------
+
+ScanVisitor::~ScanVisitor()
+{
+} // ~ScanVisitor
+
+// ----------------------------------------------------------------------------
+
+void ScanVisitor::enter(DirTree const&, DirTree::Index, std::string const&)
+{
+} // enter
+
+// ----------------------------------------------------------------------------
+
+void ScanVisitor::read(size_t, size_t)
+{
+} // read
+
+// ----------------------------------------------------------------------------
+
+void ScanVisitor::finalized(DirTree const&, DirTree::Index)
+{
+} // finalized
+
+// ----------------------------------------------------------------------------
+
+void ScanVisitor::error(std::string const& message)
+{
+    ::error(message);
+} // error
@@ -0,0 +1,80 @@
+// ScanVisitor.hpp
+//
+// ----------------------------------------------------------------------------
+//
+// Copyright (C) 2021  Jean-Marc Bourguet
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//   * Redistributions of source code must retain the above copyright
+//     notice, this list of conditions and the following disclaimer.
+//
+//   * Redistributions in binary form must reproduce the above copyright
+//     notice, this list of conditions and the following disclaimer in the
+//     documentation and/or other materials provided with the distribution.
+//
+//   * Neither the name of Jean-Marc Bourguet nor the names of other
+//     contributors may be used to endorse or promote products derived from
+//     this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+// IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+// TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+// PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+// TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+// NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+// ----------------------------------------------------------------------------
+//
+// Callbacks of a scan (see ScanOptions::visitor).  They are called by the
+// scanning threads, possibly concurrently; nodes are complete -- size and
+// subtree included -- only once finalized, children before their parent.
+// The default implementations do nothing but write the errors on the
+// standard error.
+//
+// ----------------------------------------------------------------------------
+
+#ifndef SCAN_VISITOR_HPP
+#define SCAN_VISITOR_HPP
+
+#include <stddef.h>
+#include <string>
+
+#include "DirTree.hpp"
+
+// ----------------------------------------------------------------------------
+// ScanVisitor
+// ----------------------------------------------------------------------------
+
+class ScanVisitor
+{
+public:
+    ScanVisitor();
+    virtual ~ScanVisitor();
+
+    /// node, whose path is path, is going to be read
+    virtual void enter(DirTree const& tree, DirTree::Index node, std::string const& path);
+    /// a directory has been read, with entries entries of size (in the
+    /// unit of DirTree::size)
+    virtual void read(size_t entries, size_t size);
+    /// node and its subtree are complete
+    virtual void finalized(DirTree const& tree, DirTree::Index node);
+    /// something couldn't be examined, errno tells why
+    virtual void error(std::string const& message);
+private: // and not implemented
+    ScanVisitor(ScanVisitor const&);
+    ScanVisitor& operator=(ScanVisitor const&);
+}; // ScanVisitor
+
+// ----------------------------------------------------------------------------
+
+#endif
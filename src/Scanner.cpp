@@ -0,0 +1,967 @@
+// Scanner.cpp
+//
+// ----------------------------------------------------------------------------
+//
+// Copyright (C) 2021  Jean-Marc Bourguet
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//   * Redistributions of source code must retain the above copyright
+//     notice, this list of conditions and the following disclaimer.
+//
+//   * Redistributions in binary form must reproduce the above copyright
+//     notice, this list of conditions and the following disclaimer in the
+//     documentation and/or other materials provided with the distribution.
+//
+//   * Neither the name of Jean-Marc Bourguet nor the names of other
+//     contributors may be used to endorse or promote products derived from
+//     this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+// IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+// TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+// PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+// TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+// NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// ----------------------------------------------------------------------------
+
+#include "Scanner.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <thread>
+#include <unistd.h>
+
+#include "DirInfo.hpp"
+#include "DirReader.hpp"
+#include "FileStat.hpp"
+#include "IgnoreMatcher.hpp"
+#include "InodeSet.hpp"
+#include "IoScheduler.hpp"
+#include "Stats.hpp"
+#include "UringStat.hpp"
+
+namespace
+{
+
+/// Order the nodes of a tree by name
+class NameIsSmaller
+{
+public:
+    explicit NameIsSmaller(DirTree const* tree) : myTree(tree) {}
+    bool operator()(DirTree::Index l, DirTree::Index r) const
+    {
+        return strcmp(myTree->name(l), myTree->name(r)) < 0;
+    }
+private:
+    DirTree const* myTree;
+}; // NameIsSmaller
+
+/// Order positions by inode
+class InodeIsSmaller
+{
+public:
+    explicit InodeIsSmaller(std::vector<ino_t> const& inodes) : myInodes(&inodes) {}
+    bool operator()(size_t l, size_t r) const
+    {
+        return (*myInodes)[l] < (*myInodes)[r];
+    }
+private:
+    std::vector<ino_t> const* myInodes;
+}; // InodeIsSmaller
+
+}
+
+// ----------------------------------------------------------------------------
+
+/// A directory being scanned.  It lives until all its subdirectories have
+/// been finalized.  While some of them have not been opened yet, its
+/// descriptor is kept (if the budget allows it) so that they are opened
+/// relatively to it instead of walking their full path again.
+struct Scanner::Directory
+{
+    Directory(DirTree::Index pNode, Directory* pParent, std::string const& pPath)
+        : node(pNode), parent(pParent), depth(pParent != NULL ? pParent->depth + 1 : 0),
+          path(pPath), pending(1), unopened(1),
+          fd(-1), known(false), incomplete(false), info(), lastChild(DirTree::none),
+          cached(DirTree::none), directSize(0), otherDirectSize(0), directFiles(0),
+          maxDirectEntry(0)
+    {}
+
+    DirTree::Index node;
+    Directory* parent;
+    size_t depth; // 0 for a root
+    std::string path;
+    std::atomic<size_t> pending; // unfinished subdirectories, +1 while reading
+    std::atomic<size_t> unopened; // unopened subdirectories, +1 while reading
+    int fd;
+    bool known; // info already got by the parent
+    bool incomplete; // some content couldn't be examined
+    FileInfo info;
+    DirTree::Index lastChild;
+    DirTree::Index cached; // the same directory in the cache
+    std::vector<DirTree::Index> cachedChildren; // sorted by name
+    size_t directSize;
+    size_t otherDirectSize; // see DirTree::otherSize
+    size_t directFiles;
+    size_t maxDirectEntry;
+    std::string maxDirectEntryName;
+}; // Directory
+
+// ----------------------------------------------------------------------------
+
+struct Scanner::Worker
+{
+    std::mutex mutex;
+    std::deque<Directory*> tasks;
+    std::vector<char> buffer; // for DirReader
+    size_t statsAvoided;
+    size_t untypedEntries;
+    size_t linksSkipped;
+    size_t cacheHits;
+    size_t cacheMisses;
+    size_t mountPoints;
+    size_t folded;
+    Histogram::Extensions extensions;
+
+    // for readBatched
+    UringStat* uring;
+    std::vector<char> names;
+    std::vector<size_t> nameOffsets;
+    std::vector<unsigned char> types;
+    std::vector<ino_t> inodes;
+    std::vector<size_t> statOrder; // positions of the entries examined
+    std::vector<size_t> statPositions; // in statOrder, by entry
+    std::vector<char const*> toStat;
+    std::vector<FileInfo> infos;
+    std::vector<int> errors;
+}; // Worker
+
+// ----------------------------------------------------------------------------
+
+ScanOptions::ScanOptions()
+    : threads(1),
+      logicalSize(false),
+      useIoUring(false),
+      oneFileSystem(false),
+      ignored(NULL),
+      inodes(NULL),
+      cache(NULL),
+      visitor(NULL),
+      foldBelow(0),
+      foldDepth(0),
+      adaptive(false)
+{
+} // ScanOptions
+
+// ----------------------------------------------------------------------------
+
+Scanner::Scanner(ScanOptions const& options)
+    : myOutstanding(0),
+      myQueued(0),
+      myIdle(0),
+      myHeldFds(0),
+      myFdBudget(256),
+      myLogicalSize(options.logicalSize),
+      myUseIoUring(options.useIoUring),
+      myOneFileSystem(options.oneFileSystem),
+      myIgnored(options.ignored),
+      myFoldBelow(options.foldBelow),
+      myFoldDepth(options.foldDepth),
+      myInodes(options.inodes),
+      myTree(NULL),
+      myNow(0),
+      myCache(options.cache),
+      myVisitor(options.visitor != NULL ? options.visitor : &myDefaultVisitor),
+      myScheduler(options.adaptive ? new IoScheduler(options.threads) : NULL)
+{
+    struct rlimit limit;
+    if (getrlimit(RLIMIT_NOFILE, &limit) == 0) {
+        if (limit.rlim_cur == RLIM_INFINITY || limit.rlim_cur > 8192)
+            myFdBudget = 4096;
+        else
+            myFdBudget = limit.rlim_cur / 2;
+    }
+    size_t const threads = options.threads == 0 ? 1 : options.threads;
+    for (size_t i = 0; i < threads; ++i) {
+        myWorkers.push_back(new Worker);
+        myWorkers.back()->statsAvoided = 0;
+        myWorkers.back()->untypedEntries = 0;
+        myWorkers.back()->linksSkipped = 0;
+        myWorkers.back()->cacheHits = 0;
+        myWorkers.back()->cacheMisses = 0;
+        myWorkers.back()->mountPoints = 0;
+        myWorkers.back()->folded = 0;
+        myWorkers.back()->uring = NULL;
+    }
+} // Scanner
+
+// ----------------------------------------------------------------------------
+
+Scanner::~Scanner()
+{
+    for (size_t i = 0; i < myWorkers.size(); ++i) {
+        delete myWorkers[i]->uring;
+        delete myWorkers[i];
+    }
+    delete myScheduler;
+} // ~Scanner
+
+// ----------------------------------------------------------------------------
+
+DirInfo Scanner::scan(DirTree& tree, std::string const& path)
+{
+    return scan(tree, std::vector<std::string>(1, path)).front();
+} // scan
+
+// ----------------------------------------------------------------------------
+
+std::vector<DirInfo> Scanner::scan(DirTree& tree, std::vector<std::string> const& paths)
+{
+    myTree = &tree;
+    tree.setLogical(myLogicalSize);
+    myNow = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+    myRoots.clear();
+    std::vector<DirInfo> result;
+    for (size_t p = 0; p < paths.size(); ++p) {
+        std::string const& path = paths[p];
+        DirTree::Index root = tree.addDirectory(path.c_str(), DirTree::none, DirTree::none);
+        result.push_back(DirInfo(&tree, root));
+        if (paths.size() > 1) {
+            // identify the root, as it will be scanned
+            FileInfo info;
+            int fd = openDirectory(AT_FDCWD, path.c_str(), true);
+            if (fd >= 0 && statDescriptor(fd, info) == 0) {
+                std::pair<uint64_t, uint64_t> const id(info.device, info.inode);
+                std::vector<std::pair<uint64_t, uint64_t> >::iterator pos
+                    = std::lower_bound(myRoots.begin(), myRoots.end(), id);
+                if (pos != myRoots.end() && *pos == id) {
+                    // given twice
+                    tree.setIdentity(root, info.device, info.inode, info.modified, info.changed);
+                    tree.setOtherRoot(root);
+                    myVisitor->finalized(tree, root);
+                    close(fd);
+                    continue;
+                }
+                myRoots.insert(pos, id);
+            }
+            if (fd >= 0)
+                close(fd);
+        }
+        Directory* top = new Directory(root, NULL, path);
+        if (myCache != NULL) {
+            for (DirTree::Index i = myCache->firstRoot(); i != DirTree::none;
+                 i = myCache->nextSibling(i))
+            {
+                if (path == myCache->name(i))
+                    top->cached = i;
+            }
+        }
+        push(0, top);
+    }
+    std::vector<std::thread> threads;
+    for (size_t i = 1; i < myWorkers.size(); ++i) {
+        threads.push_back(std::thread(&Scanner::run, this, i));
+    }
+    run(0);
+    for (size_t i = 0; i < threads.size(); ++i) {
+        threads[i].join();
+    }
+    return result;
+} // scan
+
+// ----------------------------------------------------------------------------
+
+size_t Scanner::statsAvoided() const
+{
+    size_t result = 0;
+    for (size_t i = 0; i < myWorkers.size(); ++i) {
+        result += myWorkers[i]->statsAvoided;
+    }
+    return result;
+} // statsAvoided
+
+// ----------------------------------------------------------------------------
+
+size_t Scanner::untypedEntries() const
+{
+    size_t result = 0;
+    for (size_t i = 0; i < myWorkers.size(); ++i) {
+        result += myWorkers[i]->untypedEntries;
+    }
+    return result;
+} // untypedEntries
+
+// ----------------------------------------------------------------------------
+
+size_t Scanner::linksSkipped() const
+{
+    size_t result = 0;
+    for (size_t i = 0; i < myWorkers.size(); ++i) {
+        result += myWorkers[i]->linksSkipped;
+    }
+    return result;
+} // linksSkipped
+
+// ----------------------------------------------------------------------------
+
+size_t Scanner::cacheHits() const
+{
+    size_t result = 0;
+    for (size_t i = 0; i < myWorkers.size(); ++i) {
+        result += myWorkers[i]->cacheHits;
+    }
+    return result;
+} // cacheHits
+
+// ----------------------------------------------------------------------------
+
+size_t Scanner::cacheMisses() const
+{
+    size_t result = 0;
+    for (size_t i = 0; i < myWorkers.size(); ++i) {
+        result += myWorkers[i]->cacheMisses;
+    }
+    return result;
+} // cacheMisses
+
+// ----------------------------------------------------------------------------
+
+size_t Scanner::mountPoints() const
+{
+    size_t result = 0;
+    for (size_t i = 0; i < myWorkers.size(); ++i) {
+        result += myWorkers[i]->mountPoints;
+    }
+    return result;
+} // mountPoints
+
+// ----------------------------------------------------------------------------
+
+size_t Scanner::folded() const
+{
+    size_t result = 0;
+    for (size_t i = 0; i < myWorkers.size(); ++i) {
+        result += myWorkers[i]->folded;
+    }
+    return result;
+} // folded
+
+// ----------------------------------------------------------------------------
+
+void Scanner::addExtensions(Histogram::Extensions& totals) const
+{
+    for (size_t i = 0; i < myWorkers.size(); ++i) {
+        Histogram::Extensions const& extensions = myWorkers[i]->extensions;
+        for (Histogram::Extensions::const_iterator e = extensions.begin();
+             e != extensions.end(); ++e)
+        {
+            std::pair<uint64_t, uint64_t>& total = totals[e->first];
+            total.first += e->second.first;
+            total.second += e->second.second;
+        }
+    }
+} // addExtensions
+
+// ----------------------------------------------------------------------------
+
+IoScheduler const* Scanner::scheduler() const
+{
+    return myScheduler;
+} // scheduler
+
+// ----------------------------------------------------------------------------
+
+void Scanner::run(size_t self)
+{
+    for (;;) {
+        Directory* dir = pop(self);
+        if (dir != NULL) {
+            process(self, dir);
+            if (--myOutstanding == 0) {
+                std::lock_guard<std::mutex> lock(myIdleMutex);
+                myIdleCondition.notify_all();
+            }
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(myIdleMutex);
+        if (myOutstanding == 0)
+            return;
+        ++myIdle;
+        while (myQueued == 0 && myOutstanding != 0) {
+            myIdleCondition.wait(lock);
+        }
+        --myIdle;
+    }
+} // run
+
+// ----------------------------------------------------------------------------
+
+void Scanner::push(size_t self, Directory* dir)
+{
+    ++myOutstanding;
+    {
+        std::lock_guard<std::mutex> lock(myWorkers[self]->mutex);
+        myWorkers[self]->tasks.push_back(dir);
+    }
+    ++myQueued;
+    if (myIdle > 0) {
+        std::lock_guard<std::mutex> lock(myIdleMutex);
+        myIdleCondition.notify_one();
+    }
+} // push
+
+// ----------------------------------------------------------------------------
+
+Scanner::Directory* Scanner::pop(size_t self)
+{
+    {
+        Worker& own = *myWorkers[self];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (!own.tasks.empty()) {
+            Directory* result = own.tasks.back();
+            own.tasks.pop_back();
+            --myQueued;
+            return result;
+        }
+    }
+    for (size_t i = 1; i < myWorkers.size(); ++i) {
+        Worker& victim = *myWorkers[(self + i) % myWorkers.size()];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.tasks.empty()) {
+            Directory* result = victim.tasks.front();
+            victim.tasks.pop_front();
+            --myQueued;
+            return result;
+        }
+    }
+    return NULL;
+} // pop
+
+// ----------------------------------------------------------------------------
+
+void Scanner::process(size_t self, Directory* dir)
+{
+    Directory* parent = dir->parent;
+    std::string const& pPath = dir->path;
+
+    myVisitor->enter(*myTree, dir->node, pPath);
+
+    // Subdirectories are known not to be symbolic links and are opened
+    // relatively to their parent when it is still open.  The top directory
+    // is handled like the original path based code did: lstat, then follow
+    // it if it is a link.
+    int atFd = AT_FDCWD;
+    char const* atName = pPath.c_str();
+    if (parent != NULL && parent->fd >= 0) {
+        atFd = parent->fd;
+        atName = myTree->name(dir->node);
+    }
+    // A subdirectory is presumed to be on the file system of its parent,
+    // mount points being rare; the number of directories read at the same
+    // time there is limited.
+    uint64_t const device = parent != NULL && parent->known ? parent->info.device : 0;
+    bool const limited = myScheduler != NULL && parent != NULL && parent->known
+        && myScheduler->acquire(device);
+    std::chrono::steady_clock::time_point start;
+    if (limited)
+        start = std::chrono::steady_clock::now();
+    size_t operations = 1;
+
+    bool const examineFirst = myOneFileSystem && parent != NULL;
+    int fd = examineFirst ? -1 : openDirectory(atFd, atName, parent == NULL);
+    int openErrno = errno;
+    if (!dir->known) {
+        int status = (fd >= 0 && parent != NULL)
+            ? statDescriptor(fd, dir->info)
+            : statEntry(atFd, atName, dir->info);
+        dir->known = status == 0;
+        if (!dir->known) {
+            myVisitor->error("Error while getting information about " + pPath);
+            dir->incomplete = true;
+        }
+    }
+    bool const mountPoint = examineFirst && dir->known && parent->known
+        && dir->info.device != parent->info.device;
+    bool const otherRoot = parent != NULL && dir->known && isRoot(dir->info);
+    if (otherRoot && fd >= 0) {
+        close(fd);
+        fd = -1;
+    }
+    bool const pruned = mountPoint || otherRoot;
+    if (examineFirst && !pruned) {
+        fd = openDirectory(atFd, atName, false);
+        openErrno = errno;
+    }
+    bool unchanged = false;
+    if (dir->known) {
+        myTree->setIdentity(dir->node, dir->info.device, dir->info.inode,
+                            dir->info.modified, dir->info.changed);
+    }
+    if (dir->known && !pruned) {
+        dir->directSize += sizeOf(dir->info);
+        dir->otherDirectSize += otherSizeOf(dir->info);
+        dir->maxDirectEntry = dir->directSize;
+        dir->maxDirectEntryName = "";
+        // a directory scanned as another root wasn't read there
+        DirTree::Index const cached = dir->cached;
+        unchanged = cached != DirTree::none && !myCache->isIncomplete(cached)
+            && !myCache->isOtherRoot(cached)
+            && myCache->device(cached) == dir->info.device
+            && myCache->inode(cached) == dir->info.inode
+            && myCache->modified(cached) == dir->info.modified
+            && myCache->changed(cached) == dir->info.changed;
+    }
+    if (myCache != NULL && !pruned) {
+        if (unchanged) {
+            ++myWorkers[self]->cacheHits;
+        } else {
+            ++myWorkers[self]->cacheMisses;
+        }
+    }
+    if (parent != NULL) {
+        release(parent);
+    }
+
+    if (mountPoint) {
+        myTree->setMountPoint(dir->node);
+        ++myWorkers[self]->mountPoints;
+    } else if (otherRoot) {
+        myTree->setOtherRoot(dir->node);
+    } else if (fd < 0) {
+        errno = openErrno;
+        myVisitor->error("Unable to open " + pPath);
+        dir->incomplete = true;
+    } else if (unchanged) {
+        if (myHeldFds < myFdBudget) {
+            ++myHeldFds;
+            dir->fd = fd;
+        } else {
+            close(fd);
+        }
+        reuse(self, dir);
+        myVisitor->read(0, dir->directSize);
+    } else {
+        if (myHeldFds < myFdBudget) {
+            ++myHeldFds;
+            dir->fd = fd;
+        }
+        if (dir->cached != DirTree::none) {
+            // a changed directory; look for its subdirectories in the cache
+            for (DirTree::Index i = myCache->firstChild(dir->cached);
+                 i != DirTree::none; i = myCache->nextSibling(i))
+            {
+                if (!myCache->isContent(i))
+                    dir->cachedChildren.push_back(i);
+            }
+            std::sort(dir->cachedChildren.begin(), dir->cachedChildren.end(),
+                      NameIsSmaller(myCache));
+        }
+        Worker& worker = *myWorkers[self];
+        DirReader reader(fd, worker.buffer);
+        if (myUseIoUring && worker.uring == NULL)
+            worker.uring = new UringStat(64);
+        bool const inodeOrder = myScheduler != NULL && dir->known
+            && myScheduler->learn(dir->info.device, fd) == IoScheduler::diskKind;
+        size_t const entries = ((worker.uring != NULL && worker.uring->ok()) || inodeOrder)
+            ? readBatched(self, dir, fd, reader, inodeOrder)
+            : readEach(self, dir, fd, reader);
+        operations += entries + 1;
+        myVisitor->read(entries, dir->directSize);
+        if (reader.error() != 0) {
+            errno = reader.error();
+            myVisitor->error("Error while reading " + pPath);
+            dir->incomplete = true;
+        }
+        if (dir->fd < 0)
+            close(fd);
+    }
+    if (limited) {
+        long long const elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - start).count();
+        myScheduler->release(device, operations, elapsed);
+    }
+    release(dir);
+    if (--dir->pending == 0) {
+        finalize(self, dir);
+    }
+} // process
+
+// ----------------------------------------------------------------------------
+
+size_t Scanner::readEach(size_t self, Directory* dir, int fd, DirReader& reader)
+{
+    Worker& worker = *myWorkers[self];
+    size_t count = 0;
+    while (reader.next()) {
+        ++count;
+        // A directory stats itself once opened, its parent doesn't need to;
+        // only when the type is unknown must the entry be examined here, and
+        // the result is then passed to the child.
+        unsigned char const type = reader.type();
+        if (type == DT_DIR) {
+            addEntry(self, dir, fd, reader.name(), NULL);
+            continue;
+        }
+        if (type == DT_UNKNOWN)
+            ++worker.untypedEntries;
+        FileInfo info;
+        if (statEntry(fd, reader.name(), info) != 0) {
+            myVisitor->error("Error while getting information about " + dir->path + '/' + reader.name());
+            dir->incomplete = true;
+            continue;
+        }
+        addEntry(self, dir, fd, reader.name(), &info);
+    }
+    return count;
+} // readEach
+
+// ----------------------------------------------------------------------------
+
+size_t Scanner::readBatched(size_t self, Directory* dir, int fd, DirReader& reader,
+                            bool inodeOrder)
+{
+    Worker& worker = *myWorkers[self];
+    worker.names.clear();
+    worker.nameOffsets.clear();
+    worker.types.clear();
+    worker.inodes.clear();
+    size_t count = 0;
+    while (reader.next()) {
+        ++count;
+        char const* name = reader.name();
+        // the subdirectories are queued at once, so that they are read while
+        // the files are examined; the ignored ones stay DT_DIR in types, to
+        // be examined and counted with the files
+        if (reader.type() == DT_DIR && addSubDirectory(self, dir, name, NULL))
+            continue;
+        worker.nameOffsets.push_back(worker.names.size());
+        worker.names.insert(worker.names.end(), name, name + strlen(name) + 1);
+        worker.types.push_back(reader.type());
+        worker.inodes.push_back(reader.inode());
+    }
+
+    worker.statOrder.clear();
+    for (size_t i = 0; i < worker.types.size(); ++i) {
+        if (worker.types[i] == DT_UNKNOWN)
+            ++worker.untypedEntries;
+        worker.statOrder.push_back(i);
+    }
+    if (inodeOrder) {
+        std::stable_sort(worker.statOrder.begin(), worker.statOrder.end(),
+                         InodeIsSmaller(worker.inodes));
+    }
+    worker.toStat.clear();
+    worker.statPositions.resize(worker.types.size());
+    for (size_t s = 0; s < worker.statOrder.size(); ++s) {
+        worker.toStat.push_back(&worker.names[worker.nameOffsets[worker.statOrder[s]]]);
+        worker.statPositions[worker.statOrder[s]] = s;
+    }
+    if (worker.uring != NULL && worker.uring->ok()) {
+        worker.uring->statAll(fd, worker.toStat, worker.infos, worker.errors);
+    } else {
+        worker.infos.resize(worker.toStat.size());
+        worker.errors.resize(worker.toStat.size());
+        for (size_t s = 0; s < worker.toStat.size(); ++s) {
+            worker.errors[s] = statEntry(fd, worker.toStat[s], worker.infos[s]) == 0 ? 0 : errno;
+        }
+    }
+
+    // The remaining entries are handled in readdir order, so that the direct
+    // content, its maximum included, is the same as with readEach; only the
+    // subdirectories of unknown type come, in the tree, after the others.
+    for (size_t i = 0; i < worker.types.size(); ++i) {
+        char const* name = &worker.names[worker.nameOffsets[i]];
+        size_t const examined = worker.statPositions[i];
+        if (worker.errors[examined] != 0) {
+            errno = worker.errors[examined];
+            myVisitor->error("Error while getting information about " + dir->path + '/' + name);
+            dir->incomplete = true;
+        } else if (worker.types[i] == DT_DIR) {
+            addDirectEntry(self, dir, name, worker.infos[examined]); // ignored
+        } else {
+            addEntry(self, dir, fd, name, &worker.infos[examined]);
+        }
+    }
+    return count;
+} // readBatched
+
+// ----------------------------------------------------------------------------
+
+void Scanner::reuse(size_t self, Directory* dir)
+{
+    DirTree::Index const cached = dir->cached;
+    // the maximum entry is recorded on the content node, if there is one
+    DirTree::Index maxNode = cached;
+    for (DirTree::Index i = myCache->firstChild(cached); i != DirTree::none;
+         i = myCache->nextSibling(i))
+    {
+        if (myCache->isContent(i)) {
+            maxNode = i;
+        } else {
+            char const* name = myCache->name(i);
+            addDirectory(self, dir, name, dir->path + '/' + name, NULL, i);
+        }
+    }
+    dir->directSize = myCache->directSize(cached);
+    dir->otherDirectSize = myCache->otherDirectSize(cached);
+    dir->directFiles = myCache->directFiles(cached);
+    char const* maxName = myCache->maxEntryName(maxNode);
+    if (maxName != NULL) {
+        dir->maxDirectEntry = myCache->maxEntrySize(maxNode);
+        dir->maxDirectEntryName = maxName;
+    }
+} // reuse
+
+// ----------------------------------------------------------------------------
+
+void Scanner::addEntry(size_t self, Directory* dir, int fd, char const* name,
+                       FileInfo const* info)
+{
+    FileInfo own;
+    if (info == NULL || info->isDirectory) {
+        if (addSubDirectory(self, dir, name, info))
+            return;
+        if (info == NULL) {
+            if (statEntry(fd, name, own) != 0) {
+                myVisitor->error("Error while getting information about " + dir->path + '/' + name);
+                dir->incomplete = true;
+                return;
+            }
+            info = &own;
+        }
+    }
+    addDirectEntry(self, dir, name, *info);
+} // addEntry
+
+// ----------------------------------------------------------------------------
+
+void Scanner::addDirectEntry(size_t self, Directory* dir, char const* name,
+                             FileInfo const& info)
+{
+    size_t size = sizeOf(info);
+    size_t otherSize = otherSizeOf(info);
+    size_t files = info.isDirectory ? 0 : 1;
+    if (myInodes != NULL && !info.isDirectory && info.links > 1
+        && !myInodes->insert(info.device, info.inode))
+    {
+        // already counted elsewhere
+        ++myWorkers[self]->linksSkipped;
+        size = 0;
+        otherSize = 0;
+        files = 0;
+    }
+    dir->directSize += size;
+    dir->otherDirectSize += otherSize;
+    dir->directFiles += files;
+    Histogram* histogram = myTree->histogram(dir->node);
+    if (histogram != NULL && files != 0) {
+        // until it is finalized, the directory has the histogram of its
+        // direct content
+        std::string const extension = Histogram::extension(name);
+        histogram->add(extension, info.size, size, info.modified, myNow);
+        std::pair<uint64_t, uint64_t>& total = myWorkers[self]->extensions[extension];
+        ++total.first;
+        total.second += size;
+    }
+    if (dir->maxDirectEntryName.empty() || size > dir->maxDirectEntry) {
+        dir->maxDirectEntry = size;
+        dir->maxDirectEntryName = name;
+    }
+} // addDirectEntry
+
+// ----------------------------------------------------------------------------
+
+bool Scanner::addSubDirectory(size_t self, Directory* dir, char const* name,
+                              FileInfo const* info)
+{
+    std::string const eName(name);
+    std::string const ePath(dir->path + '/' + eName);
+    if (myIgnored != NULL && myIgnored->matches(eName, ePath))
+        return false;
+    addDirectory(self, dir, name, ePath, info, findCached(dir, name));
+    return true;
+} // addSubDirectory
+
+// ----------------------------------------------------------------------------
+
+void Scanner::addDirectory(size_t self, Directory* dir, char const* name,
+                           std::string const& path, FileInfo const* info,
+                           DirTree::Index cached)
+{
+    dir->lastChild = myTree->addDirectory(name, dir->node, dir->lastChild);
+    Directory* subDir = new Directory(dir->lastChild, dir, path);
+    if (info != NULL) {
+        subDir->known = true;
+        subDir->info = *info;
+    }
+    subDir->cached = cached;
+    ++myWorkers[self]->statsAvoided;
+    ++dir->pending;
+    ++dir->unopened;
+    push(self, subDir);
+} // addDirectory
+
+// ----------------------------------------------------------------------------
+
+DirTree::Index Scanner::findCached(Directory* dir, char const* name) const
+{
+    std::vector<DirTree::Index> const& children = dir->cachedChildren;
+    size_t first = 0;
+    size_t last = children.size();
+    while (first < last) {
+        size_t const middle = first + (last - first) / 2;
+        int const cmp = strcmp(myCache->name(children[middle]), name);
+        if (cmp == 0)
+            return children[middle];
+        if (cmp < 0) {
+            first = middle + 1;
+        } else {
+            last = middle;
+        }
+    }
+    return DirTree::none;
+} // findCached
+
+// ----------------------------------------------------------------------------
+
+bool Scanner::isRoot(FileInfo const& info) const
+{
+    return myRoots.size() > 1
+        && std::binary_search(myRoots.begin(), myRoots.end(),
+                              std::pair<uint64_t, uint64_t>(info.device, info.inode));
+} // isRoot
+
+// ----------------------------------------------------------------------------
+
+void Scanner::release(Directory* dir)
+{
+    if (--dir->unopened == 0 && dir->fd >= 0) {
+        close(dir->fd);
+        --myHeldFds;
+    }
+} // release
+
+// ----------------------------------------------------------------------------
+
+void Scanner::finalize(size_t self, Directory* dir)
+{
+    PhaseTimer timer(aggregatePhase, true);
+    while (dir != NULL) {
+        DirTree::Index const node = dir->node;
+        size_t size = 0;
+        size_t otherSize = 0;
+        size_t files = 0;
+        // what is folded is shown as part of the content
+        size_t foldedSize = 0;
+        size_t foldedOtherSize = 0;
+        size_t foldedFiles = 0;
+        Histogram* histogram = myTree->histogram(node);
+        DirTree::Index previous = DirTree::none;
+        DirTree::Index i = myTree->firstChild(node);
+        while (i != DirTree::none) {
+            DirTree::Index const next = myTree->nextSibling(i);
+            if (isFoldable(dir, i)) {
+                foldedSize += myTree->size(i);
+                foldedOtherSize += myTree->otherSize(i);
+                foldedFiles += myTree->files(i);
+                if (histogram != NULL)
+                    histogram->merge(*myTree->histogram(i));
+                myTree->remove(i, previous);
+                ++myWorkers[self]->folded;
+            } else {
+                size += myTree->size(i);
+                otherSize += myTree->otherSize(i);
+                files += myTree->files(i);
+                previous = i;
+            }
+            i = next;
+        }
+        dir->lastChild = previous;
+        // the content is a node of its own as soon as there are others, even
+        // empty ones (mount points for instance)
+        DirTree::Index content = DirTree::none;
+        if (dir->lastChild != DirTree::none || foldedSize != 0) {
+            content = myTree->addContent(node, dir->lastChild);
+            myTree->setSize(content, dir->directSize + foldedSize);
+            myTree->setDirectSize(content, dir->directSize);
+            myTree->setOtherSize(content, dir->otherDirectSize + foldedOtherSize);
+            myTree->setOtherDirectSize(content, dir->otherDirectSize);
+            myTree->setFiles(content, dir->directFiles + foldedFiles);
+            myTree->setDirectFiles(content, dir->directFiles);
+            if (!dir->maxDirectEntryName.empty()) {
+                myTree->setMaxEntry(content, dir->maxDirectEntryName.c_str(),
+                                    dir->maxDirectEntry);
+            }
+        } else if (!dir->maxDirectEntryName.empty()) {
+            myTree->setMaxEntry(node, dir->maxDirectEntryName.c_str(), dir->maxDirectEntry);
+        }
+        myTree->setDirectSize(node, dir->directSize);
+        myTree->setSize(node, size + foldedSize + dir->directSize);
+        myTree->setOtherDirectSize(node, dir->otherDirectSize);
+        myTree->setOtherSize(node, otherSize + foldedOtherSize + dir->otherDirectSize);
+        myTree->setDirectFiles(node, dir->directFiles);
+        myTree->setFiles(node, files + foldedFiles + dir->directFiles);
+        if (dir->incomplete)
+            myTree->setIncomplete(node);
+        if (histogram != NULL) {
+            // the direct and folded files go to the content, then the
+            // subdirectories are added
+            if (content != DirTree::none)
+                *myTree->histogram(content) = *histogram;
+            for (DirTree::Index c = myTree->firstChild(node); c != content;
+                 c = myTree->nextSibling(c))
+            {
+                histogram->merge(*myTree->histogram(c));
+            }
+        }
+        myVisitor->finalized(*myTree, node);
+        Directory* parent = dir->parent;
+        delete dir;
+        dir = (parent != NULL && --parent->pending == 0) ? parent : NULL;
+    }
+} // finalize
+
+// ----------------------------------------------------------------------------
+
+size_t Scanner::sizeOf(FileInfo const& info) const
+{
+    return myLogicalSize ? size_t(info.size) : size_t(info.blocks);
+} // sizeOf
+
+// ----------------------------------------------------------------------------
+
+size_t Scanner::otherSizeOf(FileInfo const& info) const
+{
+    return myLogicalSize ? size_t(info.blocks) : size_t(info.size);
+} // otherSizeOf
+
+// ----------------------------------------------------------------------------
+
+bool Scanner::isFoldable(Directory const* dir, DirTree::Index child) const
+{
+    // the pruned directories and those on another device are kept, so are
+    // the ancestors of what is kept and the children of a directory whose
+    // device is unknown; the content node, if any, is the last child
+    DirTree::Index const first = myTree->firstChild(child);
+    return dir->known && myTree->size(child) < myFoldBelow && dir->depth >= myFoldDepth
+        && (first == DirTree::none || myTree->isContent(first))
+        && !myTree->isMountPoint(child) && !myTree->isOtherRoot(child)
+        && myTree->device(child) == dir->info.device;
+} // isFoldable
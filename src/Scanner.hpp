@@ -0,0 +1,260 @@
+// Scanner.hpp
+//
+// ----------------------------------------------------------------------------
+//
+// Copyright (C) 2021  Jean-Marc Bourguet
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//   * Redistributions of source code must retain the above copyright
+//     notice, this list of conditions and the following disclaimer.
+//
+//   * Redistributions in binary form must reproduce the above copyright
+//     notice, this list of conditions and the following disclaimer in the
+//     documentation and/or other materials provided with the distribution.
+//
+//   * Neither the name of Jean-Marc Bourguet nor the names of other
+//     contributors may be used to endorse or promote products derived from
+//     this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+// IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+// TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+// PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+// TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+// NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+// ----------------------------------------------------------------------------
+//
+// Build a DirTree by scanning the file system, possibly with several
+// threads.
+//
+// Each directory is a task.  Workers own a queue of tasks; they take their
+// own work from the back (depth first, which keeps the number of pending
+// tasks small) and steal from the front of the others' queues (the oldest
+// tasks, usually the biggest subtrees).  Entries are read with DirReader and
+// examined relatively to the directory descriptor, paths are only built for
+// subdirectories.  Each file is examined once: the directory type given by
+// readdir is trusted and a directory gets its own size from its descriptor.
+// A directory is finalized -- its size computed from its children -- by
+// whichever thread completes the last of its subdirectories.
+//
+// With a cache (the tree of a previous scan), a directory whose device,
+// inode, modification and change times are the same as in the cache is not
+// read again: its direct content and the list of its subdirectories are
+// taken from the cache.  Its subdirectories are still examined, so that only
+// the unchanged directories are reused.  The size of a file modified in
+// place, without changing its directory, is thus not updated.
+//
+// When limited to one file system, a subdirectory is examined before being
+// opened; if its device isn't the one of its parent, it is a mount point and
+// is kept in the tree as an empty, flagged, leaf.  Nothing mounted on it --
+// automounted file systems included -- is accessed.
+//
+// Several roots are scanned together, their directories shared by the same
+// workers.  The roots are identified (device and inode) before the scan: a
+// root met again, as another root or as a subdirectory, is flagged and not
+// read a second time, so overlapping roots are scanned once.
+//
+// When folding, a finalized directory below a size, deeper than a depth and
+// without subdirectories left is removed from the tree and its size and
+// file count are added to the content node of its parent.  As the subtrees
+// are finalized bottom up, the small ones are folded as they complete and
+// the tree keeps, besides the directories being read, only those which
+// would be shown with that size and depth as thresholds (and the mount
+// points and other roots, with their ancestors).  The removed nodes are
+// reused, so the memory used depends on the number of kept directories.
+//
+// When the tree keeps histograms, the files are counted in the histogram of
+// their directory as they are examined and the histograms are added up as
+// the directories are finalized, as the sizes are.  The totals by
+// extension of the whole scan are kept by each thread, and added up on
+// demand.
+//
+// When adaptive, an IoScheduler limits the directories read at the same time
+// on each file system; the threads are then rather a pool, the subdirectories
+// being taken by the idle ones as soon as they are found, while their parent
+// is still being read.  On local disks the entries of a directory are
+// examined in inode order, which follows their layout on the device (they
+// are still added in readdir order); on network file systems they are
+// examined in readdir order, which follows what readdirplus has cached.
+//
+// A Scanner holds no global state: its settings are given by a ScanOptions
+// and what happens during the scan is reported to a ScanVisitor, so that
+// several scanners may be used at the same time.
+//
+// ----------------------------------------------------------------------------
+
+#ifndef SCANNER_HPP
+#define SCANNER_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <stdint.h>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "DirInfo.hpp"
+#include "DirTree.hpp"
+#include "Histogram.hpp"
+
+#include "ScanVisitor.hpp"
+
+class DirReader;
+class IgnoreMatcher;
+class IoScheduler;
+class InodeSet;
+struct FileInfo;
+
+// ----------------------------------------------------------------------------
+// ScanOptions
+// ----------------------------------------------------------------------------
+
+/// The settings of a Scanner.  The pointed objects are not owned and must
+/// outlive the scans.
+struct ScanOptions
+{
+    ScanOptions();
+
+    /// number of scanning threads
+    size_t threads;
+    /// the sizes in the tree are in bytes, instead of 512 bytes blocks (the
+    /// other kind is kept as DirTree::otherSize)
+    bool logicalSize;
+    /// examine the entries of a directory in one io_uring batch, when
+    /// possible
+    bool useIoUring;
+    /// don't read the directories on which another file system is mounted
+    bool oneFileSystem;
+    /// directories counted as plain files, without being read (NULL for none)
+    IgnoreMatcher const* ignored;
+    /// count only once the files with several hard links recorded there
+    /// (NULL to count them each time they are seen)
+    InodeSet* inodes;
+    /// reuse the unchanged directories of this tree (NULL for none), which
+    /// must have been built with the same settings
+    DirTree const* cache;
+    /// told about the progress of the scan (NULL for the default one, which
+    /// only reports the errors); the folded nodes are reused once finalized
+    ScanVisitor* visitor;
+    /// fold the directories smaller than foldBelow (in the unit of the tree,
+    /// 0 for none) and more than foldDepth levels below their root; a cache
+    /// must not be used then, as the folded directories aren't in the tree
+    /// (nor with histograms, which aren't in the cache)
+    size_t foldBelow;
+    size_t foldDepth;
+    /// adapt the directories read concurrently on each file system to its
+    /// kind and latency, see IoScheduler
+    bool adaptive;
+}; // ScanOptions
+
+// ----------------------------------------------------------------------------
+// Scanner
+// ----------------------------------------------------------------------------
+
+class Scanner
+{
+public:
+    explicit Scanner(ScanOptions const& options);
+    ~Scanner();
+
+    /// Add the directory tree rooted at path to tree.
+    DirInfo scan(DirTree& tree, std::string const& path);
+    /// Add the directory trees rooted at paths to tree, scanning them
+    /// concurrently; returns their roots, in the same order.
+    std::vector<DirInfo> scan(DirTree& tree, std::vector<std::string> const& paths);
+
+    /// stat calls saved compared to one per entry and one per directory
+    size_t statsAvoided() const;
+    /// entries for which readdir didn't give the type
+    size_t untypedEntries() const;
+    /// hard links not counted because their inode was already seen
+    size_t linksSkipped() const;
+    /// directories reused from the cache
+    size_t cacheHits() const;
+    /// directories read again despite the cache
+    size_t cacheMisses() const;
+    /// mount points not crossed
+    size_t mountPoints() const;
+    /// directories folded into their parent
+    size_t folded() const;
+    /// add the files and sizes by extension of the scans to totals, when the
+    /// tree keeps histograms
+    void addExtensions(Histogram::Extensions& totals) const;
+    /// NULL unless adaptive
+    IoScheduler const* scheduler() const;
+private: // and not implemented
+    Scanner(Scanner const&);
+    Scanner& operator=(Scanner const&);
+
+private:
+    struct Directory;
+    struct Worker;
+
+    void run(size_t self);
+    void push(size_t self, Directory* dir);
+    Directory* pop(size_t self);
+    void process(size_t self, Directory* dir);
+    /// both return the number of entries read
+    size_t readEach(size_t self, Directory* dir, int fd, DirReader& reader);
+    size_t readBatched(size_t self, Directory* dir, int fd, DirReader& reader,
+                       bool inodeOrder);
+    void reuse(size_t self, Directory* dir);
+    void addEntry(size_t self, Directory* dir, int fd, char const* name,
+                  FileInfo const* info);
+    /// add the entry described by info, which isn't a subdirectory read, to
+    /// the direct content of dir
+    void addDirectEntry(size_t self, Directory* dir, char const* name, FileInfo const& info);
+    /// false if name is ignored
+    bool addSubDirectory(size_t self, Directory* dir, char const* name,
+                         FileInfo const* info);
+    void addDirectory(size_t self, Directory* dir, char const* name,
+                      std::string const& path, FileInfo const* info,
+                      DirTree::Index cached);
+    DirTree::Index findCached(Directory* dir, char const* name) const;
+    bool isRoot(FileInfo const& info) const;
+    void release(Directory* dir);
+    void finalize(size_t self, Directory* dir);
+    bool isFoldable(Directory const* dir, DirTree::Index child) const;
+    size_t sizeOf(FileInfo const& info) const;
+    size_t otherSizeOf(FileInfo const& info) const;
+
+    std::vector<Worker*> myWorkers;
+    std::atomic<size_t> myOutstanding;
+    std::atomic<size_t> myQueued;
+    std::atomic<size_t> myIdle;
+    std::atomic<size_t> myHeldFds;
+    size_t myFdBudget;
+    bool myLogicalSize;
+    bool myUseIoUring;
+    bool myOneFileSystem;
+    IgnoreMatcher const* myIgnored;
+    size_t myFoldBelow;
+    size_t myFoldDepth;
+    InodeSet* myInodes;
+    DirTree* myTree;
+    long long myNow; // start of the scan, for the ages
+    DirTree const* myCache;
+    ScanVisitor myDefaultVisitor;
+    ScanVisitor* myVisitor;
+    IoScheduler* myScheduler;
+    std::vector<std::pair<uint64_t, uint64_t> > myRoots; // sorted (device, inode)
+    std::mutex myIdleMutex;
+    std::condition_variable myIdleCondition;
+}; // Scanner
+
+// ----------------------------------------------------------------------------
+
+#endif
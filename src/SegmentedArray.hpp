@@ -0,0 +1,242 @@
+// SegmentedArray.hpp
+//
+// ----------------------------------------------------------------------------
+//
+// Copyright (C) 2021  Jean-Marc Bourguet
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//   * Redistributions of source code must retain the above copyright
+//     notice, this list of conditions and the following disclaimer.
+//
+//   * Redistributions in binary form must reproduce the above copyright
+//     notice, this list of conditions and the following disclaimer in the
+//     documentation and/or other materials provided with the distribution.
+//
+//   * Neither the name of Jean-Marc Bourguet nor the names of other
+//     contributors may be used to endorse or promote products derived from
+//     this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+// IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+// TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+// PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+// TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+// NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+// ----------------------------------------------------------------------------
+//
+//
+// An array growing by segments which are never moved: segment k holds
+// Base << k elements, so that a few tens of segments are enough whatever
+// the size, and an element keeps its address once created.  Elements which
+// are already there may be accessed while another thread (holding whatever
+// lock protects growth) adds new ones.
+//
+// As segment k starts at index Base * (2^k - 1), the array can also be a
+// view on contiguous data, for instance a mapped file (see attach).
+//
+// ----------------------------------------------------------------------------
+
+#ifndef SEGMENTED_ARRAY_HPP
+#define SEGMENTED_ARRAY_HPP
+
+#include <stddef.h>
+#include <stdexcept>
+
+// ----------------------------------------------------------------------------
+// SegmentedArray
+// ----------------------------------------------------------------------------
+
+template <typename T, unsigned BaseBits>
+class SegmentedArray
+{
+public:
+    SegmentedArray();
+    ~SegmentedArray();
+
+    T& operator[](size_t i);
+    T const& operator[](size_t i) const;
+
+    size_t size() const;
+    /// bytes allocated for the segments
+    size_t memoryUsed() const;
+
+    /// Add n elements, all in the same segment; returns the index of the
+    /// first one.
+    size_t grow(size_t n);
+
+    /// The used part of segment k, NULL after the last one
+    T const* segment(unsigned k, size_t& length) const;
+
+    /// Become a view on size contiguous elements, which are not owned; such
+    /// an array must not grow.
+    void attach(T* data, size_t size);
+private: // and not implemented
+    SegmentedArray(SegmentedArray const&);
+    SegmentedArray& operator=(SegmentedArray const&);
+
+private:
+    static size_t const base = size_t(1) << BaseBits;
+    static unsigned const maxSegments = 40;
+
+    static unsigned segmentOf(size_t i);
+    static size_t startOf(unsigned segment);
+
+    void release();
+
+    T* mySegments[maxSegments];
+    size_t mySize;
+    bool myOwned;
+}; // SegmentedArray
+
+// ----------------------------------------------------------------------------
+
+template <typename T, unsigned BaseBits>
+SegmentedArray<T, BaseBits>::SegmentedArray()
+    : mySize(0),
+      myOwned(true)
+{
+    for (unsigned i = 0; i < maxSegments; ++i) {
+        mySegments[i] = NULL;
+    }
+} // SegmentedArray
+
+// ----------------------------------------------------------------------------
+
+template <typename T, unsigned BaseBits>
+SegmentedArray<T, BaseBits>::~SegmentedArray()
+{
+    release();
+} // ~SegmentedArray
+
+// ----------------------------------------------------------------------------
+
+template <typename T, unsigned BaseBits>
+void SegmentedArray<T, BaseBits>::release()
+{
+    for (unsigned i = 0; i < maxSegments; ++i) {
+        if (myOwned)
+            delete[] mySegments[i];
+        mySegments[i] = NULL;
+    }
+} // release
+
+// ----------------------------------------------------------------------------
+
+template <typename T, unsigned BaseBits>
+unsigned SegmentedArray<T, BaseBits>::segmentOf(size_t i)
+{
+    // segment k starts at base * (2^k - 1)
+    unsigned long long j = (i >> BaseBits) + 1;
+    return unsigned(63 - __builtin_clzll(j));
+} // segmentOf
+
+// ----------------------------------------------------------------------------
+
+template <typename T, unsigned BaseBits>
+size_t SegmentedArray<T, BaseBits>::startOf(unsigned segment)
+{
+    return base * ((size_t(1) << segment) - 1);
+} // startOf
+
+// ----------------------------------------------------------------------------
+
+template <typename T, unsigned BaseBits>
+T& SegmentedArray<T, BaseBits>::operator[](size_t i)
+{
+    unsigned const segment = segmentOf(i);
+    return mySegments[segment][i - startOf(segment)];
+} // operator[]
+
+// ----------------------------------------------------------------------------
+
+template <typename T, unsigned BaseBits>
+T const& SegmentedArray<T, BaseBits>::operator[](size_t i) const
+{
+    unsigned const segment = segmentOf(i);
+    return mySegments[segment][i - startOf(segment)];
+} // operator[]
+
+// ----------------------------------------------------------------------------
+
+template <typename T, unsigned BaseBits>
+size_t SegmentedArray<T, BaseBits>::size() const
+{
+    return mySize;
+} // size
+
+// ----------------------------------------------------------------------------
+
+template <typename T, unsigned BaseBits>
+size_t SegmentedArray<T, BaseBits>::memoryUsed() const
+{
+    size_t result = 0;
+    if (!myOwned)
+        return 0;
+    for (unsigned i = 0; i < maxSegments; ++i) {
+        if (mySegments[i] != NULL)
+            result += (base << i) * sizeof(T);
+    }
+    return result;
+} // memoryUsed
+
+// ----------------------------------------------------------------------------
+
+template <typename T, unsigned BaseBits>
+size_t SegmentedArray<T, BaseBits>::grow(size_t n)
+{
+    size_t start = mySize;
+    unsigned segment = segmentOf(start);
+    // skip the end of the segment if the elements wouldn't fit in it
+    while (start + n > startOf(segment + 1)) {
+        ++segment;
+        start = startOf(segment);
+    }
+    if (segment >= maxSegments)
+        throw std::length_error("SegmentedArray too big");
+    if (mySegments[segment] == NULL)
+        mySegments[segment] = new T[base << segment];
+    mySize = start + n;
+    return start;
+} // grow
+
+// ----------------------------------------------------------------------------
+
+template <typename T, unsigned BaseBits>
+T const* SegmentedArray<T, BaseBits>::segment(unsigned k, size_t& length) const
+{
+    size_t const start = startOf(k);
+    if (k >= maxSegments || start >= mySize)
+        return NULL;
+    length = mySize - start;
+    if (length > base << k)
+        length = base << k;
+    return mySegments[k];
+} // segment
+
+// ----------------------------------------------------------------------------
+
+template <typename T, unsigned BaseBits>
+void SegmentedArray<T, BaseBits>::attach(T* data, size_t size)
+{
+    release();
+    myOwned = false;
+    mySize = size;
+    for (unsigned k = 0; k < maxSegments && startOf(k) < size; ++k) {
+        mySegments[k] = data + startOf(k);
+    }
+} // attach
+
+// ----------------------------------------------------------------------------
+
+#endif
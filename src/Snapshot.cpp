@@ -0,0 +1,343 @@
+// Snapshot.cpp
+//
+// ----------------------------------------------------------------------------
+//
+// Copyright (C) 2021  Jean-Marc Bourguet
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//   * Redistributions of source code must retain the above copyright
+//     notice, this list of conditions and the following disclaimer.
+//
+//   * Redistributions in binary form must reproduce the above copyright
+//     notice, this list of conditions and the following disclaimer in the
+//     documentation and/or other materials provided with the distribution.
+//
+//   * Neither the name of Jean-Marc Bourguet nor the names of other
+//     contributors may be used to endorse or promote products derived from
+//     this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+// IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+// TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+// PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+// TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+// NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// ----------------------------------------------------------------------------
+
+#include "Snapshot.hpp"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+#include "DirTree.hpp"
+
+namespace
+{
+
+char const magic[8] = "DIRSIZE";
+uint32_t const version = 2;
+uint32_t const byteOrderMark = 0x01020304;
+
+enum Array {
+    sizesArray, directSizesArray, parentsArray, firstChildrenArray,
+    nextSiblingsArray, namesArray, maxEntryNamesArray, maxEntrySizesArray,
+    flagsArray, devicesArray, inodesArray, modifiedArray, changedArray,
+    otherSizesArray, otherDirectSizesArray, filesArray, directFilesArray,
+    stringsArray, arrayCount
+};
+
+struct Header
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t byteOrder;
+    uint64_t nodeCount;
+    uint64_t stringsSize;
+    uint64_t settingsSize;
+    uint64_t offsets[arrayCount];
+};
+
+uint64_t align(uint64_t offset)
+{
+    return (offset + 7) & ~uint64_t(7);
+}
+
+bool pad(FILE* file, uint64_t written)
+{
+    static char const zeros[8] = { 0 };
+    size_t const n = align(written) - written;
+    return fwrite(zeros, 1, n, file) == n;
+}
+
+template <typename T, unsigned BaseBits>
+bool writeArray(FILE* file, SegmentedArray<T, BaseBits> const& array)
+{
+    size_t length;
+    T const* data;
+    for (unsigned k = 0; (data = array.segment(k, length)) != NULL; ++k) {
+        if (fwrite(data, sizeof(T), length, file) != length)
+            return false;
+    }
+    return pad(file, array.size() * sizeof(T));
+}
+
+template <typename T, unsigned BaseBits>
+bool attachArray(SegmentedArray<T, BaseBits>& array, char* base,
+                 size_t length, uint64_t offset, uint64_t count)
+{
+    if (offset > length || count > (length - offset) / sizeof(T))
+        return false;
+    array.attach(reinterpret_cast<T*>(base + offset), count);
+    return true;
+}
+
+}
+
+// ----------------------------------------------------------------------------
+
+Snapshot::Snapshot()
+    : myData(NULL),
+      myLength(0)
+{
+} // Snapshot
+
+// ----------------------------------------------------------------------------
+
+Snapshot::~Snapshot()
+{
+    unmap();
+} // ~Snapshot
+
+// ----------------------------------------------------------------------------
+
+void Snapshot::unmap()
+{
+    if (myData != NULL)
+        munmap(myData, myLength);
+    myData = NULL;
+    myLength = 0;
+} // unmap
+
+// ----------------------------------------------------------------------------
+
+bool Snapshot::save(DirTree const& tree, std::string const& settings,
+                    std::string const& file)
+{
+    uint64_t const nodes = tree.nodeCount();
+    uint64_t const sizes[arrayCount] = {
+        nodes * sizeof(uint64_t), nodes * sizeof(uint64_t),
+        nodes * sizeof(DirTree::Index), nodes * sizeof(DirTree::Index),
+        nodes * sizeof(DirTree::Index), nodes * sizeof(uint64_t),
+        nodes * sizeof(uint64_t), nodes * sizeof(uint64_t),
+        nodes * sizeof(uint8_t), nodes * sizeof(uint64_t),
+        nodes * sizeof(uint64_t), nodes * sizeof(int64_t),
+        nodes * sizeof(int64_t), nodes * sizeof(uint64_t),
+        nodes * sizeof(uint64_t), nodes * sizeof(uint64_t),
+        nodes * sizeof(uint64_t), tree.myStrings.size()
+    };
+
+    Header header;
+    memset(&header, 0, sizeof header);
+    memcpy(header.magic, magic, sizeof header.magic);
+    header.version = version;
+    header.byteOrder = byteOrderMark;
+    header.nodeCount = nodes;
+    header.stringsSize = tree.myStrings.size();
+    header.settingsSize = settings.size();
+    uint64_t offset = align(sizeof header + settings.size());
+    for (int i = 0; i < arrayCount; ++i) {
+        header.offsets[i] = offset;
+        offset = align(offset + sizes[i]);
+    }
+
+    std::string const temporary = file + ".tmp";
+    FILE* out = fopen(temporary.c_str(), "wb");
+    if (out == NULL)
+        return false;
+    bool ok = fwrite(&header, sizeof header, 1, out) == 1
+        && fwrite(settings.data(), 1, settings.size(), out) == settings.size()
+        && pad(out, sizeof header + settings.size())
+        && writeArray(out, tree.mySizes)
+        && writeArray(out, tree.myDirectSizes)
+        && writeArray(out, tree.myParents)
+        && writeArray(out, tree.myFirstChildren)
+        && writeArray(out, tree.myNextSiblings)
+        && writeArray(out, tree.myNames)
+        && writeArray(out, tree.myMaxEntryNames)
+        && writeArray(out, tree.myMaxEntrySizes)
+        && writeArray(out, tree.myFlags)
+        && writeArray(out, tree.myDevices)
+        && writeArray(out, tree.myInodes)
+        && writeArray(out, tree.myModified)
+        && writeArray(out, tree.myChanged)
+        && writeArray(out, tree.myOtherSizes)
+        && writeArray(out, tree.myOtherDirectSizes)
+        && writeArray(out, tree.myFiles)
+        && writeArray(out, tree.myDirectFiles)
+        && writeArray(out, tree.myStrings);
+    int savedErrno = errno;
+    if (fclose(out) != 0 && ok) {
+        ok = false;
+        savedErrno = errno;
+    }
+    if (ok && rename(temporary.c_str(), file.c_str()) != 0) {
+        ok = false;
+        savedErrno = errno;
+    }
+    if (!ok) {
+        unlink(temporary.c_str());
+        errno = savedErrno;
+    }
+    return ok;
+} // save
+
+// ----------------------------------------------------------------------------
+
+bool Snapshot::load(std::string const& file, DirTree& tree)
+{
+    unmap();
+    int fd = open(file.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return false;
+    struct stat buf;
+    if (fstat(fd, &buf) != 0) {
+        int const savedErrno = errno;
+        close(fd);
+        errno = savedErrno;
+        return false;
+    }
+    if (size_t(buf.st_size) < sizeof(Header)) {
+        close(fd);
+        errno = EINVAL;
+        return false;
+    }
+    // private and writable, so that the arrays can be attached to it; the
+    // pages are never written and are thus shared with the page cache.
+    void* data = mmap(NULL, size_t(buf.st_size), PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE, fd, 0);
+    int const savedErrno = errno;
+    close(fd);
+    if (data == MAP_FAILED) {
+        errno = savedErrno;
+        return false;
+    }
+    myData = data;
+    myLength = size_t(buf.st_size);
+
+    char* base = static_cast<char*>(myData);
+    Header const& header = *static_cast<Header const*>(myData);
+    uint64_t const nodes = header.nodeCount;
+    bool ok = memcmp(header.magic, magic, sizeof header.magic) == 0
+        && header.version == version
+        && header.byteOrder == byteOrderMark
+        && nodes < DirTree::none
+        && header.settingsSize <= myLength - sizeof header
+        && attachArray(tree.mySizes, base, myLength, header.offsets[sizesArray], nodes)
+        && attachArray(tree.myDirectSizes, base, myLength, header.offsets[directSizesArray], nodes)
+        && attachArray(tree.myParents, base, myLength, header.offsets[parentsArray], nodes)
+        && attachArray(tree.myFirstChildren, base, myLength, header.offsets[firstChildrenArray], nodes)
+        && attachArray(tree.myNextSiblings, base, myLength, header.offsets[nextSiblingsArray], nodes)
+        && attachArray(tree.myNames, base, myLength, header.offsets[namesArray], nodes)
+        && attachArray(tree.myMaxEntryNames, base, myLength, header.offsets[maxEntryNamesArray], nodes)
+        && attachArray(tree.myMaxEntrySizes, base, myLength, header.offsets[maxEntrySizesArray], nodes)
+        && attachArray(tree.myFlags, base, myLength, header.offsets[flagsArray], nodes)
+        && attachArray(tree.myDevices, base, myLength, header.offsets[devicesArray], nodes)
+        && attachArray(tree.myInodes, base, myLength, header.offsets[inodesArray], nodes)
+        && attachArray(tree.myModified, base, myLength, header.offsets[modifiedArray], nodes)
+        && attachArray(tree.myChanged, base, myLength, header.offsets[changedArray], nodes)
+        && attachArray(tree.myOtherSizes, base, myLength, header.offsets[otherSizesArray], nodes)
+        && attachArray(tree.myOtherDirectSizes, base, myLength,
+                       header.offsets[otherDirectSizesArray], nodes)
+        && attachArray(tree.myFiles, base, myLength, header.offsets[filesArray], nodes)
+        && attachArray(tree.myDirectFiles, base, myLength, header.offsets[directFilesArray], nodes)
+        && attachArray(tree.myStrings, base, myLength, header.offsets[stringsArray],
+                       header.stringsSize)
+        && isValid(tree);
+    if (!ok) {
+        unmap();
+        errno = EINVAL;
+        return false;
+    }
+    mySettings.assign(base + sizeof header, header.settingsSize);
+    tree.myLastRoot = DirTree::none;
+    for (DirTree::Index i = tree.firstRoot(); i != DirTree::none; i = tree.nextSibling(i)) {
+        tree.myLastRoot = i;
+    }
+    return true;
+} // load
+
+// ----------------------------------------------------------------------------
+
+bool Snapshot::isValid(DirTree const& tree)
+{
+    size_t const nodes = tree.mySizes.size();
+    size_t const stringsSize = tree.myStrings.size();
+    // every name ends in the pool
+    if (stringsSize != 0 && tree.myStrings[stringsSize - 1] != '\0')
+        return false;
+    for (size_t i = 0; i < nodes; ++i) {
+        if ((tree.myParents[i] != DirTree::none && tree.myParents[i] >= nodes)
+            || (tree.myFirstChildren[i] != DirTree::none && tree.myFirstChildren[i] >= nodes)
+            || (tree.myNextSiblings[i] != DirTree::none && tree.myNextSiblings[i] >= nodes)
+            || (tree.myNames[i] != DirTree::noName && tree.myNames[i] >= stringsSize)
+            || (tree.myMaxEntryNames[i] != DirTree::noName
+                && tree.myMaxEntryNames[i] >= stringsSize))
+        {
+            return false;
+        }
+    }
+    // each node reached from the roots is reached once, from its parent, so
+    // that the walks of the tree end (the removed nodes aren't reached)
+    std::vector<bool> reached(nodes, false);
+    std::vector<DirTree::Index> pending;
+    for (DirTree::Index i = tree.firstRoot(); i != DirTree::none; i = tree.myNextSiblings[i]) {
+        if (reached[i] || tree.myParents[i] != DirTree::none)
+            return false;
+        reached[i] = true;
+        pending.push_back(i);
+    }
+    while (!pending.empty()) {
+        DirTree::Index const parent = pending.back();
+        pending.pop_back();
+        for (DirTree::Index i = tree.myFirstChildren[parent]; i != DirTree::none;
+             i = tree.myNextSiblings[i])
+        {
+            if (reached[i] || tree.myParents[i] != parent)
+                return false;
+            reached[i] = true;
+            pending.push_back(i);
+        }
+    }
+    return true;
+} // isValid
+
+// ----------------------------------------------------------------------------
+
+std::string const& Snapshot::settings() const
+{
+    return mySettings;
+} // settings
+
+// ----------------------------------------------------------------------------
+
+size_t Snapshot::fileSize() const
+{
+    return myLength;
+} // fileSize
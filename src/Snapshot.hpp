@@ -0,0 +1,101 @@
+// Snapshot.hpp
+//
+// ----------------------------------------------------------------------------
+//
+// Copyright (C) 2021  Jean-Marc Bourguet
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//   * Redistributions of source code must retain the above copyright
+//     notice, this list of conditions and the following disclaimer.
+//
+//   * Redistributions in binary form must reproduce the above copyright
+//     notice, this list of conditions and the following disclaimer in the
+//     documentation and/or other materials provided with the distribution.
+//
+//   * Neither the name of Jean-Marc Bourguet nor the names of other
+//     contributors may be used to endorse or promote products derived from
+//     this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+// IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+// TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+// PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+// TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+// NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+// ----------------------------------------------------------------------------
+//
+// A DirTree saved in a file, in a compact binary form which is mapped back
+// in memory when loaded: the arrays of the tree become views on the mapping
+// and the names are used in place, so that loading costs only the mapping.
+//
+// The file starts with a header (magic, version, byte order mark, node count,
+// the settings the tree was built with and the offsets of the arrays), then
+// each array of DirTree, aligned on 8 bytes, in native byte order.  A file
+// written on a machine with another byte order is rejected, so is a file
+// whose indices or name offsets are out of bounds or whose nodes, reached
+// from the roots, don't form a tree.
+//
+// ----------------------------------------------------------------------------
+
+#ifndef SNAPSHOT_HPP
+#define SNAPSHOT_HPP
+
+#include <stddef.h>
+#include <string>
+
+class DirTree;
+
+// ----------------------------------------------------------------------------
+// Snapshot
+// ----------------------------------------------------------------------------
+
+class Snapshot
+{
+public:
+    Snapshot();
+    /// The trees loaded from the snapshot must not be used afterwards.
+    ~Snapshot();
+
+    /// Write tree to file (through a temporary file renamed at the end).
+    /// settings describe the options which influence the content of the
+    /// tree.  Returns false and sets errno on failure.
+    static bool save(DirTree const& tree, std::string const& settings,
+                     std::string const& file);
+
+    /// Map file and make tree, which must be empty, a read only view on it.
+    /// Returns false and sets errno on failure (EINVAL if the file is not a
+    /// snapshot with the current version and byte order).
+    bool load(std::string const& file, DirTree& tree);
+
+    /// settings of the loaded tree
+    std::string const& settings() const;
+    /// size of the mapping
+    size_t fileSize() const;
+private: // and not implemented
+    Snapshot(Snapshot const&);
+    Snapshot& operator=(Snapshot const&);
+
+private:
+    /// the indices and names of tree, just attached, are usable
+    static bool isValid(DirTree const& tree);
+    void unmap();
+
+    void* myData;
+    size_t myLength;
+    std::string mySettings;
+}; // Snapshot
+
+// ----------------------------------------------------------------------------
+
+#endif
@@ -0,0 +1,156 @@
+// Stats.cpp
+//
+// ----------------------------------------------------------------------------
+//
+// Copyright (C) 2021  Jean-Marc Bourguet
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//   * Redistributions of source code must retain the above copyright
+//     notice, this list of conditions and the following disclaimer.
+//
+//   * Redistributions in binary form must reproduce the above copyright
+//     notice, this list of conditions and the following disclaimer in the
+//     documentation and/or other materials provided with the distribution.
+//
+//   * Neither the name of Jean-Marc Bourguet nor the names of other
+//     contributors may be used to endorse or promote products derived from
+//     this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+// IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+// TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+// PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+// TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+// NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// ----------------------------------------------------------------------------
+
+#include "Stats.hpp"
+
+#include <atomic>
+#include <iomanip>
+#include <locale>
+#include <sstream>
+#include <sys/resource.h>
+#include <time.h>
+
+namespace
+{
+
+/// on its own cache line, the scanning threads update them concurrently
+struct alignas(64) Counter
+{
+    std::atomic<uint64_t> value;
+};
+
+Counter theSysCalls[sysCallKinds];
+Counter theWallTimes[phaseKinds];
+Counter theCpuTimes[phaseKinds];
+bool theTimePhases = false;
+
+char const* const sysCallNames[sysCallKinds] = {
+    "open", "getdents", "statx", "stat", "io_uring_enter", "io_uring_statx"
+};
+
+char const* const phaseNames[phaseKinds] = {
+    "scan", "aggregate", "collect", "output"
+};
+
+int64_t now(clockid_t clock)
+{
+    struct timespec ts;
+    clock_gettime(clock, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+double seconds(Counter const& counter)
+{
+    return double(counter.value.load()) / 1e9;
+}
+
+}
+
+// ----------------------------------------------------------------------------
+
+void countSysCall(SysCall call)
+{
+    theSysCalls[call].value.fetch_add(1, std::memory_order_relaxed);
+} // countSysCall
+
+// ----------------------------------------------------------------------------
+
+void setTimePhases(bool v)
+{
+    theTimePhases = v;
+} // setTimePhases
+
+// ----------------------------------------------------------------------------
+
+bool timePhases()
+{
+    return theTimePhases;
+} // timePhases
+
+// ----------------------------------------------------------------------------
+
+void writeStats(std::ostream& os, size_t nodes, size_t treeBytes, size_t threads)
+{
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+
+    std::ostringstream json;
+    json.imbue(std::locale::classic());
+    json << std::fixed << std::setprecision(6);
+    json << "{\"syscalls\": {";
+    for (int i = 0; i < sysCallKinds; ++i) {
+        json << (i == 0 ? "" : ", ") << '"' << sysCallNames[i] << "\": "
+             << theSysCalls[i].value.load();
+    }
+    json << "}, \"phases\": {";
+    for (int i = 0; i < phaseKinds; ++i) {
+        json << (i == 0 ? "" : ", ") << '"' << phaseNames[i] << "\": {\"wall_s\": "
+             << seconds(theWallTimes[i]) << ", \"cpu_s\": " << seconds(theCpuTimes[i]) << '}';
+    }
+    json << "}, \"peak_rss_bytes\": " << usage.ru_maxrss * 1024LL
+         << ", \"nodes\": " << nodes
+         << ", \"tree_bytes\": " << treeBytes
+         << ", \"threads\": " << threads << "}\n";
+    os << json.str() << std::flush;
+} // writeStats
+
+// ----------------------------------------------------------------------------
+
+PhaseTimer::PhaseTimer(Phase phase, bool perThread)
+    : myPhase(phase),
+      myActive(theTimePhases),
+      myPerThread(perThread),
+      myWallStart(0),
+      myCpuStart(0)
+{
+    if (myActive) {
+        myWallStart = now(CLOCK_MONOTONIC);
+        myCpuStart = now(myPerThread ? CLOCK_THREAD_CPUTIME_ID : CLOCK_PROCESS_CPUTIME_ID);
+    }
+} // PhaseTimer
+
+// ----------------------------------------------------------------------------
+
+PhaseTimer::~PhaseTimer()
+{
+    if (myActive) {
+        int64_t const cpu
+            = now(myPerThread ? CLOCK_THREAD_CPUTIME_ID : CLOCK_PROCESS_CPUTIME_ID) - myCpuStart;
+        int64_t const wall = now(CLOCK_MONOTONIC) - myWallStart;
+        theWallTimes[myPhase].value.fetch_add(uint64_t(wall), std::memory_order_relaxed);
+        theCpuTimes[myPhase].value.fetch_add(uint64_t(cpu), std::memory_order_relaxed);
+    }
+} // ~PhaseTimer
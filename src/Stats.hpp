@@ -0,0 +1,96 @@
+// Stats.hpp
+//
+// ----------------------------------------------------------------------------
+//
+// Copyright (C) 2021  Jean-Marc Bourguet
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//   * Redistributions of source code must retain the above copyright
+//     notice, this list of conditions and the following disclaimer.
+//
+//   * Redistributions in binary form must reproduce the above copyright
+//     notice, this list of conditions and the following disclaimer in the
+//     documentation and/or other materials provided with the distribution.
+//
+//   * Neither the name of Jean-Marc Bourguet nor the names of other
+//     contributors may be used to endorse or promote products derived from
+//     this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+// IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+// TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+// PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+// TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+// NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+// ----------------------------------------------------------------------------
+//
+// Instrumentation of a run, reported by --stats: the system calls done by
+// kind, and the wall and CPU times spent in each phase.  The counters are
+// always maintained, the phases are timed only when asked for.
+//
+// ----------------------------------------------------------------------------
+
+#ifndef STATS_HPP
+#define STATS_HPP
+
+#include <ostream>
+#include <stddef.h>
+#include <stdint.h>
+
+enum SysCall {
+    openCall, getdentsCall, statxCall, statCall, uringEnterCall, uringStatxCall,
+    sysCallKinds
+};
+
+enum Phase {
+    scanPhase,
+    aggregatePhase, // during the scan, summed over the threads
+    collectPhase,
+    outputPhase,
+    phaseKinds
+};
+
+void countSysCall(SysCall call);
+void setTimePhases(bool);
+bool timePhases();
+
+/// Write the statistics as a JSON object
+void writeStats(std::ostream& os, size_t nodes, size_t treeBytes, size_t threads);
+
+// ----------------------------------------------------------------------------
+// PhaseTimer
+// ----------------------------------------------------------------------------
+
+/// Add the time of its life to a phase, if phases are timed
+class PhaseTimer
+{
+public:
+    /// perThread: measure the CPU time of the thread, not of the process
+    explicit PhaseTimer(Phase phase, bool perThread = false);
+    ~PhaseTimer();
+private: // and not implemented
+    PhaseTimer(PhaseTimer const&);
+    PhaseTimer& operator=(PhaseTimer const&);
+
+private:
+    Phase myPhase;
+    bool myActive;
+    bool myPerThread;
+    int64_t myWallStart;
+    int64_t myCpuStart;
+}; // PhaseTimer
+
+// ----------------------------------------------------------------------------
+
+#endif
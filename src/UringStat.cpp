@@ -0,0 +1,264 @@
+// UringStat.cpp
+//
+// ----------------------------------------------------------------------------
+//
+// Copyright (C) 2021  Jean-Marc Bourguet
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//   * Redistributions of source code must retain the above copyright
+//     notice, this list of conditions and the following disclaimer.
+//
+//   * Redistributions in binary form must reproduce the above copyright
+//     notice, this list of conditions and the following disclaimer in the
+//     documentation and/or other materials provided with the distribution.
+//
+//   * Neither the name of Jean-Marc Bourguet nor the names of other
+//     contributors may be used to endorse or promote products derived from
+//     this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+// IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+// TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+// PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+// TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+// NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// ----------------------------------------------------------------------------
+
+#include "UringStat.hpp"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+
+#ifdef HAVE_IO_URING
+#include <linux/io_uring.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include "FileStat.hpp"
+#include "Stats.hpp"
+
+// ----------------------------------------------------------------------------
+
+#ifdef HAVE_IO_URING
+
+struct UringStat::Ring
+{
+    int fd;
+    unsigned entries;
+    bool usable; // cleared if the kernel doesn't know IORING_OP_STATX
+
+    void* sqMap;
+    size_t sqMapSize;
+    void* cqMap;
+    size_t cqMapSize;
+    io_uring_sqe* sqes;
+    size_t sqesSize;
+
+    unsigned* sqHead;
+    unsigned* sqTail;
+    unsigned* sqMask;
+    unsigned* sqArray;
+    unsigned* cqHead;
+    unsigned* cqTail;
+    unsigned* cqMask;
+    io_uring_cqe* cqes;
+
+    std::vector<struct statx> buffers; // one per slot
+    std::vector<unsigned> freeSlots;
+}; // Ring
+
+namespace
+{
+
+template <typename T>
+T* at(void* base, unsigned offset)
+{
+    return reinterpret_cast<T*>(static_cast<char*>(base) + offset);
+}
+
+void* mapRing(int fd, size_t size, unsigned long long offset)
+{
+    void* result = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                        fd, static_cast<off_t>(offset));
+    return result == MAP_FAILED ? NULL : result;
+}
+
+}
+
+#else
+
+struct UringStat::Ring
+{
+}; // Ring
+
+#endif
+
+// ----------------------------------------------------------------------------
+
+UringStat::UringStat(unsigned depth)
+    : myRing(NULL)
+{
+#ifdef HAVE_IO_URING
+    io_uring_params params;
+    memset(&params, 0, sizeof params);
+    int fd = int(syscall(__NR_io_uring_setup, depth, &params));
+    if (fd < 0)
+        return;
+
+    Ring* ring = new Ring;
+    ring->fd = fd;
+    ring->entries = params.sq_entries;
+    ring->usable = true;
+    ring->sqMapSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    ring->cqMapSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    bool const single = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (single) {
+        if (ring->cqMapSize > ring->sqMapSize)
+            ring->sqMapSize = ring->cqMapSize;
+        ring->cqMapSize = ring->sqMapSize;
+    }
+    ring->sqMap = mapRing(fd, ring->sqMapSize, IORING_OFF_SQ_RING);
+    ring->cqMap = single ? ring->sqMap : mapRing(fd, ring->cqMapSize, IORING_OFF_CQ_RING);
+    ring->sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+    ring->sqes = static_cast<io_uring_sqe*>(mapRing(fd, ring->sqesSize, IORING_OFF_SQES));
+    myRing = ring;
+    if (ring->sqMap == NULL || ring->cqMap == NULL || ring->sqes == NULL) {
+        ring->usable = false;
+        return;
+    }
+
+    ring->sqHead = at<unsigned>(ring->sqMap, params.sq_off.head);
+    ring->sqTail = at<unsigned>(ring->sqMap, params.sq_off.tail);
+    ring->sqMask = at<unsigned>(ring->sqMap, params.sq_off.ring_mask);
+    ring->sqArray = at<unsigned>(ring->sqMap, params.sq_off.array);
+    ring->cqHead = at<unsigned>(ring->cqMap, params.cq_off.head);
+    ring->cqTail = at<unsigned>(ring->cqMap, params.cq_off.tail);
+    ring->cqMask = at<unsigned>(ring->cqMap, params.cq_off.ring_mask);
+    ring->cqes = at<io_uring_cqe>(ring->cqMap, params.cq_off.cqes);
+    ring->buffers.resize(ring->entries);
+    for (unsigned i = 0; i < ring->entries; ++i) {
+        ring->freeSlots.push_back(i);
+    }
+#else
+    (void)depth;
+#endif
+} // UringStat
+
+// ----------------------------------------------------------------------------
+
+UringStat::~UringStat()
+{
+#ifdef HAVE_IO_URING
+    if (myRing != NULL) {
+        if (myRing->sqes != NULL)
+            munmap(myRing->sqes, myRing->sqesSize);
+        if (myRing->cqMap != NULL && myRing->cqMap != myRing->sqMap)
+            munmap(myRing->cqMap, myRing->cqMapSize);
+        if (myRing->sqMap != NULL)
+            munmap(myRing->sqMap, myRing->sqMapSize);
+        close(myRing->fd);
+    }
+#endif
+    delete myRing;
+} // ~UringStat
+
+// ----------------------------------------------------------------------------
+
+bool UringStat::ok() const
+{
+#ifdef HAVE_IO_URING
+    return myRing != NULL && myRing->usable;
+#else
+    return false;
+#endif
+} // ok
+
+// ----------------------------------------------------------------------------
+
+void UringStat::statAll(int dirFd, std::vector<char const*> const& names,
+                        std::vector<FileInfo>& infos, std::vector<int>& errors)
+{
+    size_t const count = names.size();
+    infos.resize(count);
+    errors.assign(count, -1); // not done yet
+#ifdef HAVE_IO_URING
+    Ring* ring = myRing;
+    size_t next = 0;
+    size_t inFlight = 0;
+    while (ok() && (next < count || inFlight > 0)) {
+        // fill the free slots...
+        unsigned tail = *ring->sqTail;
+        while (next < count && !ring->freeSlots.empty()) {
+            unsigned const slot = ring->freeSlots.back();
+            ring->freeSlots.pop_back();
+            unsigned const index = tail & *ring->sqMask;
+            io_uring_sqe& sqe = ring->sqes[index];
+            memset(&sqe, 0, sizeof sqe);
+            sqe.opcode = IORING_OP_STATX;
+            countSysCall(uringStatxCall);
+            sqe.fd = dirFd;
+            sqe.addr = reinterpret_cast<unsigned long long>(names[next]);
+            sqe.len = statxFields();
+            sqe.off = reinterpret_cast<unsigned long long>(&ring->buffers[slot]);
+            sqe.statx_flags = AT_SYMLINK_NOFOLLOW;
+            sqe.user_data = (static_cast<unsigned long long>(next) << 32) | slot;
+            ring->sqArray[index] = index;
+            ++tail;
+            ++next;
+            ++inFlight;
+        }
+        __atomic_store_n(ring->sqTail, tail, __ATOMIC_RELEASE);
+
+        // ... and wait for at least one completion; the entries not taken
+        // by a previous call (interrupted or partial) are submitted again
+        unsigned const pending = tail - __atomic_load_n(ring->sqHead, __ATOMIC_ACQUIRE);
+        countSysCall(uringEnterCall);
+        if (syscall(__NR_io_uring_enter, ring->fd, pending, 1U,
+                    IORING_ENTER_GETEVENTS, NULL, 0) < 0
+            && errno != EINTR)
+        {
+            ring->usable = false;
+            break;
+        }
+
+        unsigned head = *ring->cqHead;
+        unsigned const cqTail = __atomic_load_n(ring->cqTail, __ATOMIC_ACQUIRE);
+        for ( ; head != cqTail; ++head) {
+            io_uring_cqe const& cqe = ring->cqes[head & *ring->cqMask];
+            size_t const i = size_t(cqe.user_data >> 32);
+            unsigned const slot = unsigned(cqe.user_data & 0xFFFFFFFFU);
+            if (cqe.res == -EINVAL) {
+                // IORING_OP_STATX unknown, done below synchronously
+                ring->usable = false;
+            } else if (cqe.res < 0) {
+                errors[i] = -cqe.res;
+            } else if (fromStatx(ring->buffers[slot], infos[i])) {
+                errors[i] = 0;
+            }
+            ring->freeSlots.push_back(slot);
+            --inFlight;
+        }
+        __atomic_store_n(ring->cqHead, head, __ATOMIC_RELEASE);
+    }
+#endif
+    // whatever wasn't handled by the ring
+    for (size_t i = 0; i < count; ++i) {
+        if (errors[i] == -1) {
+            errors[i] = statEntry(dirFd, names[i], infos[i]) == 0 ? 0 : errno;
+        }
+    }
+} // statAll
@@ -0,0 +1,82 @@
+// UringStat.hpp
+//
+// ----------------------------------------------------------------------------
+//
+// Copyright (C) 2021  Jean-Marc Bourguet
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//   * Redistributions of source code must retain the above copyright
+//     notice, this list of conditions and the following disclaimer.
+//
+//   * Redistributions in binary form must reproduce the above copyright
+//     notice, this list of conditions and the following disclaimer in the
+//     documentation and/or other materials provided with the distribution.
+//
+//   * Neither the name of Jean-Marc Bourguet nor the names of other
+//     contributors may be used to endorse or promote products derived from
+//     this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+// IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+// TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+// PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+// TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+// NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+// ----------------------------------------------------------------------------
+//
+// Examine the entries of a directory in batches through io_uring: all the
+// statx requests of a directory are queued at once and the kernel runs them
+// concurrently, keeping the device queue full.  Used only when io_uring was
+// found at build time (HAVE_IO_URING) and can be set up at run time; ok()
+// tells if it is the case.
+//
+// ----------------------------------------------------------------------------
+
+#ifndef URING_STAT_HPP
+#define URING_STAT_HPP
+
+#include <vector>
+
+struct FileInfo;
+
+// ----------------------------------------------------------------------------
+// UringStat
+// ----------------------------------------------------------------------------
+
+class UringStat
+{
+public:
+    explicit UringStat(unsigned depth);
+    ~UringStat();
+
+    bool ok() const;
+
+    /// Examine names[i] relatively to dirFd for all i, without following
+    /// symbolic links.  errors[i] is 0 if infos[i] has been filled, the errno
+    /// value otherwise.
+    void statAll(int dirFd, std::vector<char const*> const& names,
+                 std::vector<FileInfo>& infos, std::vector<int>& errors);
+private: // and not implemented
+    UringStat(UringStat const&);
+    UringStat& operator=(UringStat const&);
+
+private:
+    struct Ring;
+
+    Ring* myRing;
+}; // UringStat
+
+// ----------------------------------------------------------------------------
+
+#endif
@@ -0,0 +1,735 @@
+// Watcher.cpp
+//
+// ----------------------------------------------------------------------------
+//
+// Copyright (C) 2021  Jean-Marc Bourguet
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//   * Redistributions of source code must retain the above copyright
+//     notice, this list of conditions and the following disclaimer.
+//
+//   * Redistributions in binary form must reproduce the above copyright
+//     notice, this list of conditions and the following disclaimer in the
+//     documentation and/or other materials provided with the distribution.
+//
+//   * Neither the name of Jean-Marc Bourguet nor the names of other
+//     contributors may be used to endorse or promote products derived from
+//     this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+// IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+// TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+// PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+// TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+// NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// ----------------------------------------------------------------------------
+
+#include "Watcher.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#endif
+
+#include "DirReader.hpp"
+#include "FileStat.hpp"
+#include "IgnoreMatcher.hpp"
+
+namespace
+{
+
+/// inotify instances used at most, the default limit being 128 by user
+size_t const maxGroups = 32;
+
+size_t adjusted(size_t value, long long delta)
+{
+    return static_cast<size_t>(static_cast<long long>(value) + delta);
+}
+
+/// the path of node, DirInfo::path being for display; the scan gives it to
+/// enter, this is for the changes
+std::string pathOf(DirTree const& tree, DirTree::Index node)
+{
+    DirTree::Index const parent = tree.parent(node);
+    if (parent == DirTree::none)
+        return tree.name(node);
+    return pathOf(tree, parent) + '/' + tree.name(node);
+}
+
+long long difference(size_t value, size_t previous)
+{
+    return static_cast<long long>(value) - static_cast<long long>(previous);
+}
+
+int addWatch(int fd, std::string const& path, bool followLink)
+{
+#ifdef __linux__
+    uint32_t mask = IN_CREATE | IN_DELETE | IN_MODIFY | IN_MOVED_FROM | IN_MOVED_TO
+        | IN_ONLYDIR | IN_EXCL_UNLINK;
+    if (!followLink)
+        mask |= IN_DONT_FOLLOW;
+    return inotify_add_watch(fd, path.c_str(), mask);
+#else
+    (void)fd;
+    (void)path;
+    (void)followLink;
+    errno = ENOSYS;
+    return -1;
+#endif
+}
+
+void removeWatch(int fd, int descriptor)
+{
+#ifdef __linux__
+    // fails harmlessly if the kernel already removed it
+    inotify_rm_watch(fd, descriptor);
+#else
+    (void)fd;
+    (void)descriptor;
+#endif
+}
+
+}
+
+// ----------------------------------------------------------------------------
+// Watcher::Group
+// ----------------------------------------------------------------------------
+
+/// An inotify instance
+struct Watcher::Group
+{
+    Group();
+    ~Group();
+
+    int fd;
+    std::unordered_map<int, DirTree::Index> nodes; // by watch descriptor
+    std::vector<DirTree::Index> keys; // the roots or subdirectories of roots watched
+    bool overflowed;
+private: // and not implemented
+    Group(Group const&);
+    Group& operator=(Group const&);
+}; // Group
+
+// ----------------------------------------------------------------------------
+
+Watcher::Group::Group()
+    : fd(-1),
+      overflowed(false)
+{
+#ifdef __linux__
+    fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+#endif
+} // Group
+
+// ----------------------------------------------------------------------------
+
+Watcher::Group::~Group()
+{
+    if (fd >= 0)
+        close(fd);
+} // ~Group
+
+// ----------------------------------------------------------------------------
+// Watcher
+// ----------------------------------------------------------------------------
+
+Watcher::Watcher(DirTree& tree, ScanOptions const& options)
+    : myTree(&tree),
+      myOptions(options),
+      myNext(options.visitor),
+      myPendingGroup(0),
+      myUnwatched(0),
+      myRefreshed(0),
+      myRescanned(0)
+{
+    myOptions.visitor = this;
+    myOptions.cache = NULL;
+    myGroups.push_back(new Group());
+} // Watcher
+
+// ----------------------------------------------------------------------------
+
+Watcher::~Watcher()
+{
+    for (size_t i = 0; i < myGroups.size(); ++i) {
+        delete myGroups[i];
+    }
+} // ~Watcher
+
+// ----------------------------------------------------------------------------
+
+bool Watcher::ok() const
+{
+    return myGroups[0]->fd >= 0;
+} // ok
+
+// ----------------------------------------------------------------------------
+
+void Watcher::scanned()
+{
+    myNext = NULL;
+    std::vector<DirTree::Index> pruned;
+    for (std::unordered_map<DirTree::Index, std::pair<size_t, int> >::const_iterator
+             i = myWatches.begin(), end = myWatches.end(); i != end; ++i)
+    {
+        if (myTree->isMountPoint(i->first) || myTree->isOtherRoot(i->first))
+            pruned.push_back(i->first);
+    }
+    for (size_t i = 0; i < pruned.size(); ++i) {
+        unwatch(pruned[i]);
+    }
+} // scanned
+
+// ----------------------------------------------------------------------------
+
+bool Watcher::update(int timeout)
+{
+    // the events are read as they come, to keep the queues short, but a
+    // directory is read again only once
+    typedef std::chrono::steady_clock Clock;
+    Clock::time_point const end = Clock::now() + std::chrono::milliseconds(timeout);
+    std::vector<pollfd> fds(myGroups.size());
+    for (size_t i = 0; i < fds.size(); ++i) {
+        fds[i].fd = myGroups[i]->fd;
+        fds[i].events = POLLIN;
+    }
+    for (;;) {
+        long long const remaining
+            = std::chrono::duration_cast<std::chrono::milliseconds>(end - Clock::now()).count();
+        if (remaining <= 0)
+            break;
+        int const count = poll(fds.data(), fds.size(), int(remaining));
+        if (count < 0 && errno != EINTR) {
+            error("Error while waiting for changes");
+            break;
+        }
+        for (size_t i = 0; count > 0 && i < fds.size(); ++i) {
+            if ((fds[i].revents & POLLIN) != 0)
+                readEvents(i);
+        }
+    }
+    bool overflowed = false;
+    for (size_t i = 0; i < myGroups.size(); ++i) {
+        overflowed = overflowed || myGroups[i]->overflowed;
+    }
+    if (!overflowed && myChanged.empty())
+        return false;
+
+    // The events of an overflowed queue are lost: its subtrees are scanned
+    // again, then the directories which have changed are read again.
+    for (size_t i = 0; i < myGroups.size(); ++i) {
+        if (!myGroups[i]->overflowed)
+            continue;
+        myGroups[i]->overflowed = false;
+        std::vector<DirTree::Index> const keys(myGroups[i]->keys);
+        for (size_t k = 0; k < keys.size(); ++k) {
+            std::unordered_map<DirTree::Index, size_t>::const_iterator found
+                = myGroupOfKeys.find(keys[k]);
+            // a key may have been removed with its parent
+            if (found != myGroupOfKeys.end() && found->second == i)
+                rescan(keys[k]);
+        }
+    }
+    while (!myChanged.empty()) {
+        std::pair<size_t, int> const changed = *myChanged.begin();
+        myChanged.erase(myChanged.begin());
+        Group const& group = *myGroups[changed.first];
+        std::unordered_map<int, DirTree::Index>::const_iterator found
+            = group.nodes.find(changed.second);
+        // not found if removed meanwhile
+        if (found != group.nodes.end())
+            refresh(found->second);
+    }
+    return true;
+} // update
+
+// ----------------------------------------------------------------------------
+
+size_t Watcher::watched() const
+{
+    return myWatches.size();
+} // watched
+
+// ----------------------------------------------------------------------------
+
+size_t Watcher::unwatched() const
+{
+    return myUnwatched;
+} // unwatched
+
+// ----------------------------------------------------------------------------
+
+size_t Watcher::refreshed() const
+{
+    return myRefreshed;
+} // refreshed
+
+// ----------------------------------------------------------------------------
+
+size_t Watcher::rescanned() const
+{
+    return myRescanned;
+} // rescanned
+
+// ----------------------------------------------------------------------------
+
+void Watcher::enter(DirTree const& tree, DirTree::Index node, std::string const& path)
+{
+    if (&tree == myTree) {
+        size_t group;
+        {
+            std::lock_guard<std::mutex> lock(myMutex);
+            group = groupOf(node);
+        }
+        watch(group, tree, node, path);
+    } else {
+        // a subtree scanned again, to be copied in the tree
+        watch(myPendingGroup, tree, node, path);
+    }
+    if (myNext != NULL)
+        myNext->enter(tree, node, path);
+} // enter
+
+// ----------------------------------------------------------------------------
+
+void Watcher::read(size_t entries, size_t size)
+{
+    if (myNext != NULL)
+        myNext->read(entries, size);
+} // read
+
+// ----------------------------------------------------------------------------
+
+void Watcher::finalized(DirTree const& tree, DirTree::Index node)
+{
+    if (myNext != NULL)
+        myNext->finalized(tree, node);
+} // finalized
+
+// ----------------------------------------------------------------------------
+
+void Watcher::error(std::string const& message)
+{
+    if (myNext != NULL) {
+        myNext->error(message);
+    } else {
+        ScanVisitor::error(message);
+    }
+} // error
+
+// ----------------------------------------------------------------------------
+
+size_t Watcher::groupOf(DirTree::Index node)
+{
+    // the key of a node is its root or the subdirectory of its root
+    // containing it
+    DirTree::Index key = node;
+    DirTree::Index parent = myTree->parent(key);
+    while (parent != DirTree::none && myTree->parent(parent) != DirTree::none) {
+        key = parent;
+        parent = myTree->parent(key);
+    }
+    std::unordered_map<DirTree::Index, size_t>::const_iterator found = myGroupOfKeys.find(key);
+    if (found != myGroupOfKeys.end())
+        return found->second;
+    size_t const result = parent == DirTree::none ? 0 : newGroup();
+    myGroupOfKeys[key] = result;
+    myGroups[result]->keys.push_back(key);
+    return result;
+} // groupOf
+
+// ----------------------------------------------------------------------------
+
+size_t Watcher::newGroup()
+{
+    if (!myFreeGroups.empty()) {
+        size_t const result = myFreeGroups.back();
+        myFreeGroups.pop_back();
+        return result;
+    }
+    if (myGroups.size() >= maxGroups)
+        return 0;
+    Group* group = new Group();
+    if (group->fd < 0) {
+        // out of instances, share the first one
+        delete group;
+        return 0;
+    }
+    myGroups.push_back(group);
+    return myGroups.size() - 1;
+} // newGroup
+
+// ----------------------------------------------------------------------------
+
+void Watcher::watch(size_t group, DirTree const& tree, DirTree::Index node,
+                    std::string const& path)
+{
+    int fd;
+    {
+        std::lock_guard<std::mutex> lock(myMutex);
+        fd = myGroups[group]->fd;
+    }
+    int const descriptor = addWatch(fd, path, tree.parent(node) == DirTree::none);
+    std::lock_guard<std::mutex> lock(myMutex);
+    if (descriptor < 0) {
+        ++myUnwatched;
+    } else if (&tree == myTree) {
+        myGroups[group]->nodes[descriptor] = node;
+        myWatches[node] = std::make_pair(group, descriptor);
+    } else {
+        myPending.push_back(std::make_pair(node, descriptor));
+    }
+} // watch
+
+// ----------------------------------------------------------------------------
+
+void Watcher::unwatch(DirTree::Index node)
+{
+    std::unordered_map<DirTree::Index, std::pair<size_t, int> >::iterator found
+        = myWatches.find(node);
+    if (found == myWatches.end())
+        return;
+    Group& group = *myGroups[found->second.first];
+    removeWatch(group.fd, found->second.second);
+    group.nodes.erase(found->second.second);
+    myWatches.erase(found);
+} // unwatch
+
+// ----------------------------------------------------------------------------
+
+void Watcher::readEvents(size_t group)
+{
+#ifdef __linux__
+    Group& current = *myGroups[group];
+    alignas(inotify_event) char buffer[16384];
+    for (;;) {
+        ssize_t const length = ::read(current.fd, buffer, sizeof buffer);
+        if (length <= 0)
+            break; // EAGAIN once all have been read
+        char const* end = buffer + length;
+        for (char const* p = buffer; p < end; ) {
+            inotify_event const* event = reinterpret_cast<inotify_event const*>(p);
+            p += sizeof(inotify_event) + event->len;
+            if ((event->mask & IN_Q_OVERFLOW) != 0) {
+                current.overflowed = true;
+            } else if ((event->mask & IN_IGNORED) != 0) {
+                // the directory is gone, or was unmounted
+                std::unordered_map<int, DirTree::Index>::iterator found
+                    = current.nodes.find(event->wd);
+                if (found != current.nodes.end()) {
+                    myWatches.erase(found->second);
+                    current.nodes.erase(found);
+                }
+            } else {
+                myChanged.insert(std::make_pair(group, event->wd));
+            }
+        }
+    }
+#else
+    (void)group;
+#endif
+} // readEvents
+
+// ----------------------------------------------------------------------------
+
+void Watcher::refresh(DirTree::Index node)
+{
+    ++myRefreshed;
+    std::string const path = pathOf(*myTree, node);
+    int const fd = openDirectory(AT_FDCWD, path.c_str(), myTree->parent(node) == DirTree::none);
+    if (fd < 0)
+        return; // removed, its parent will be read again, or unreadable
+    FileInfo info;
+    if (statDescriptor(fd, info) != 0) {
+        close(fd);
+        return;
+    }
+    myTree->setIdentity(node, info.device, info.inode, info.modified, info.changed);
+
+    // the direct content, as Scanner counts it
+    size_t directSize = sizeOf(info);
+    size_t otherDirectSize = otherSizeOf(info);
+    size_t directFiles = 0;
+    size_t maxEntry = directSize;
+    std::string maxEntryName;
+    std::vector<std::string> subDirs;
+    DirReader reader(fd, myBuffer);
+    while (reader.next()) {
+        std::string const name(reader.name());
+        FileInfo entry;
+        bool examined = false;
+        bool isDirectory = reader.type() == DT_DIR;
+        if (!isDirectory) {
+            if (statEntry(fd, reader.name(), entry) != 0)
+                continue; // removed meanwhile
+            examined = true;
+            isDirectory = entry.isDirectory;
+        }
+        if (isDirectory && (myOptions.ignored == NULL
+                            || !myOptions.ignored->matches(name, path + '/' + name)))
+        {
+            subDirs.push_back(name);
+            continue;
+        }
+        if (!examined && statEntry(fd, reader.name(), entry) != 0)
+            continue;
+        size_t const size = sizeOf(entry);
+        directSize += size;
+        otherDirectSize += otherSizeOf(entry);
+        if (!entry.isDirectory)
+            ++directFiles;
+        if (maxEntryName.empty() || size > maxEntry) {
+            maxEntry = size;
+            maxEntryName = name;
+        }
+    }
+    close(fd);
+
+    propagate(node, difference(directSize, myTree->directSize(node)),
+              difference(otherDirectSize, myTree->otherDirectSize(node)),
+              difference(directFiles, myTree->directFiles(node)));
+    myTree->setDirectSize(node, directSize);
+    myTree->setOtherDirectSize(node, otherDirectSize);
+    myTree->setDirectFiles(node, directFiles);
+
+    // the subdirectories which disappeared are removed, the new ones added
+    std::sort(subDirs.begin(), subDirs.end());
+    std::vector<std::pair<std::string, DirTree::Index> > children;
+    for (DirTree::Index i = myTree->firstChild(node); i != DirTree::none;
+         i = myTree->nextSibling(i))
+    {
+        if (!myTree->isContent(i))
+            children.push_back(std::make_pair(std::string(myTree->name(i)), i));
+    }
+    std::sort(children.begin(), children.end());
+    size_t c = 0;
+    for (size_t i = 0; i < subDirs.size(); ++i) {
+        while (c < children.size() && children[c].first < subDirs[i]) {
+            removeSubtree(children[c].second);
+            ++c;
+        }
+        if (c < children.size() && children[c].first == subDirs[i]) {
+            ++c;
+        } else {
+            addSubtree(node, subDirs[i]);
+        }
+    }
+    for (; c < children.size(); ++c) {
+        removeSubtree(children[c].second);
+    }
+
+    // as after a scan, the content has its own node if there are
+    // subdirectories
+    DirTree::Index content = DirTree::none;
+    DirTree::Index beforeContent = DirTree::none;
+    bool hasSubDirs = false;
+    for (DirTree::Index i = myTree->firstChild(node); i != DirTree::none;
+         i = myTree->nextSibling(i))
+    {
+        if (myTree->isContent(i)) {
+            content = i;
+        } else {
+            hasSubDirs = true;
+            if (content == DirTree::none)
+                beforeContent = i;
+        }
+    }
+    if (hasSubDirs && content == DirTree::none) {
+        content = myTree->addContent(node, lastChild(node));
+        myTree->setMaxEntry(node, NULL, 0);
+    } else if (!hasSubDirs && content != DirTree::none) {
+        myTree->remove(content, beforeContent);
+        content = DirTree::none;
+    }
+    char const* maxName = maxEntryName.empty() ? NULL : maxEntryName.c_str();
+    if (content != DirTree::none) {
+        myTree->setSize(content, directSize);
+        myTree->setDirectSize(content, directSize);
+        myTree->setOtherSize(content, otherDirectSize);
+        myTree->setOtherDirectSize(content, otherDirectSize);
+        myTree->setFiles(content, directFiles);
+        myTree->setDirectFiles(content, directFiles);
+        myTree->setMaxEntry(content, maxName, maxEntry);
+    } else {
+        myTree->setMaxEntry(node, maxName, maxEntry);
+    }
+} // refresh
+
+// ----------------------------------------------------------------------------
+
+void Watcher::rescan(DirTree::Index node)
+{
+    ++myRescanned;
+    DirTree::Index const parent = myTree->parent(node);
+    if (parent == DirTree::none) {
+        // the subdirectories of a root have their own keys
+        refresh(node);
+        return;
+    }
+    std::string const name(myTree->name(node));
+    removeSubtree(node);
+    FileInfo info;
+    std::string const path = pathOf(*myTree, parent) + '/' + name;
+    if (statEntry(AT_FDCWD, path.c_str(), info) == 0 && info.isDirectory)
+        addSubtree(parent, name);
+} // rescan
+
+// ----------------------------------------------------------------------------
+
+void Watcher::addSubtree(DirTree::Index parent, std::string const& name)
+{
+    bool const isKey = myTree->parent(parent) == DirTree::none;
+    myPendingGroup = isKey ? newGroup() : groupOf(parent);
+    myPending.clear();
+    DirTree subTree;
+    {
+        Scanner scanner(myOptions);
+        scanner.scan(subTree, pathOf(*myTree, parent) + '/' + name);
+    }
+    std::vector<DirTree::Index> copies(subTree.nodeCount(), DirTree::none);
+    DirTree::Index const node = copy(subTree, subTree.firstRoot(), parent, lastChild(parent),
+                                     name.c_str(), copies);
+    Group& group = *myGroups[myPendingGroup];
+    for (size_t i = 0; i < myPending.size(); ++i) {
+        DirTree::Index const copied = copies[myPending[i].first];
+        int const descriptor = myPending[i].second;
+        if (copied == DirTree::none || myTree->isMountPoint(copied)
+            || myTree->isOtherRoot(copied))
+        {
+            removeWatch(group.fd, descriptor);
+        } else {
+            group.nodes[descriptor] = copied;
+            myWatches[copied] = std::make_pair(myPendingGroup, descriptor);
+        }
+    }
+    myPending.clear();
+    if (isKey) {
+        myGroupOfKeys[node] = myPendingGroup;
+        group.keys.push_back(node);
+    }
+    propagate(parent, static_cast<long long>(myTree->size(node)),
+              static_cast<long long>(myTree->otherSize(node)),
+              static_cast<long long>(myTree->files(node)));
+} // addSubtree
+
+// ----------------------------------------------------------------------------
+
+void Watcher::removeSubtree(DirTree::Index node)
+{
+    DirTree::Index const parent = myTree->parent(node);
+    propagate(parent, -static_cast<long long>(myTree->size(node)),
+              -static_cast<long long>(myTree->otherSize(node)),
+              -static_cast<long long>(myTree->files(node)));
+    std::vector<DirTree::Index> pending(1, node);
+    while (!pending.empty()) {
+        DirTree::Index const current = pending.back();
+        pending.pop_back();
+        unwatch(current);
+        for (DirTree::Index i = myTree->firstChild(current); i != DirTree::none;
+             i = myTree->nextSibling(i))
+        {
+            pending.push_back(i);
+        }
+    }
+    std::unordered_map<DirTree::Index, size_t>::iterator found = myGroupOfKeys.find(node);
+    if (found != myGroupOfKeys.end()) {
+        std::vector<DirTree::Index>& keys = myGroups[found->second]->keys;
+        keys.erase(std::find(keys.begin(), keys.end(), node));
+        if (found->second != 0)
+            myFreeGroups.push_back(found->second);
+        myGroupOfKeys.erase(found);
+    }
+    DirTree::Index previous = DirTree::none;
+    for (DirTree::Index i = myTree->firstChild(parent); i != node; i = myTree->nextSibling(i)) {
+        previous = i;
+    }
+    myTree->remove(node, previous);
+} // removeSubtree
+
+// ----------------------------------------------------------------------------
+
+DirTree::Index Watcher::copy(DirTree const& from, DirTree::Index node, DirTree::Index parent,
+                             DirTree::Index previous, char const* name,
+                             std::vector<DirTree::Index>& copies)
+{
+    DirTree::Index const result = from.isContent(node)
+        ? myTree->addContent(parent, previous)
+        : myTree->addDirectory(name, parent, previous);
+    copies[node] = result;
+    myTree->setSize(result, from.size(node));
+    myTree->setDirectSize(result, from.directSize(node));
+    myTree->setOtherSize(result, from.otherSize(node));
+    myTree->setOtherDirectSize(result, from.otherDirectSize(node));
+    myTree->setFiles(result, from.files(node));
+    myTree->setDirectFiles(result, from.directFiles(node));
+    if (from.maxEntryName(node) != NULL)
+        myTree->setMaxEntry(result, from.maxEntryName(node), from.maxEntrySize(node));
+    if (from.isIncomplete(node))
+        myTree->setIncomplete(result);
+    if (from.isMountPoint(node))
+        myTree->setMountPoint(result);
+    if (from.isOtherRoot(node))
+        myTree->setOtherRoot(result);
+    myTree->setIdentity(result, from.device(node), from.inode(node), from.modified(node),
+                        from.changed(node));
+    DirTree::Index last = DirTree::none;
+    for (DirTree::Index i = from.firstChild(node); i != DirTree::none; i = from.nextSibling(i)) {
+        last = copy(from, i, result, last, from.name(i), copies);
+    }
+    return result;
+} // copy
+
+// ----------------------------------------------------------------------------
+
+void Watcher::propagate(DirTree::Index node, long long size, long long otherSize,
+                        long long files)
+{
+    for (DirTree::Index i = node; i != DirTree::none; i = myTree->parent(i)) {
+        myTree->setSize(i, adjusted(myTree->size(i), size));
+        myTree->setOtherSize(i, adjusted(myTree->otherSize(i), otherSize));
+        myTree->setFiles(i, adjusted(myTree->files(i), files));
+    }
+} // propagate
+
+// ----------------------------------------------------------------------------
+
+DirTree::Index Watcher::lastChild(DirTree::Index node) const
+{
+    DirTree::Index result = DirTree::none;
+    for (DirTree::Index i = myTree->firstChild(node); i != DirTree::none;
+         i = myTree->nextSibling(i))
+    {
+        result = i;
+    }
+    return result;
+} // lastChild
+
+// ----------------------------------------------------------------------------
+
+size_t Watcher::sizeOf(FileInfo const& info) const
+{
+    return myOptions.logicalSize ? size_t(info.size) : size_t(info.blocks);
+} // sizeOf
+
+// ----------------------------------------------------------------------------
+
+size_t Watcher::otherSizeOf(FileInfo const& info) const
+{
+    return myOptions.logicalSize ? size_t(info.blocks) : size_t(info.size);
+} // otherSizeOf
@@ -0,0 +1,160 @@
+// Watcher.hpp
+//
+// ----------------------------------------------------------------------------
+//
+// Copyright (C) 2021  Jean-Marc Bourguet
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//   * Redistributions of source code must retain the above copyright
+//     notice, this list of conditions and the following disclaimer.
+//
+//   * Redistributions in binary form must reproduce the above copyright
+//     notice, this list of conditions and the following disclaimer in the
+//     documentation and/or other materials provided with the distribution.
+//
+//   * Neither the name of Jean-Marc Bourguet nor the names of other
+//     contributors may be used to endorse or promote products derived from
+//     this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+// IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+// TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+// PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+// TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+// NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+// ----------------------------------------------------------------------------
+//
+//
+// Keep a scanned DirTree up to date with inotify.
+//
+// The Watcher is the visitor of the initial scan and watches each directory
+// as it is entered, before it is read, so that nothing happening during the
+// scan is lost.  An event on a directory only marks it as changed; at the
+// end of each update, a changed directory is read again, once whatever the
+// number of its events, without its subdirectories: its
+// direct content is recomputed, the differences with the previous values are
+// added to it and to all its ancestors, the subdirectories which disappeared
+// are removed and the new ones are scanned and added.  A directory renamed is
+// thus removed and scanned again under its new name.
+//
+// The kernel queue of events may overflow, the events lost are unknown and
+// the directories concerned must be scanned again.  To limit that rescan,
+// each subdirectory of a root (up to a number of them) has its own inotify
+// instance, and thus its own queue; only the subtrees of the instance which
+// overflowed are rescanned.  The roots themselves, and the subdirectories
+// beyond that number, share an instance.
+//
+// The sizes of the files modified in place are known from the events of
+// their directory.  The watches are not set on the mount points and the
+// other roots, which aren't read.  Folding, histograms and counting the hard
+// links once are not supported: they depend on what isn't in the tree.
+//
+// ----------------------------------------------------------------------------
+
+#ifndef WATCHER_HPP
+#define WATCHER_HPP
+
+#include <mutex>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "DirTree.hpp"
+#include "ScanVisitor.hpp"
+#include "Scanner.hpp"
+
+// ----------------------------------------------------------------------------
+// Watcher
+// ----------------------------------------------------------------------------
+
+class Watcher
+    : public ScanVisitor
+{
+public:
+    /// options are those of the scan of tree, whose visitor is told about
+    /// the initial scan; the watcher must be the visitor of that scan.
+    Watcher(DirTree& tree, ScanOptions const& options);
+    virtual ~Watcher();
+
+    /// inotify is available
+    bool ok() const;
+    /// To be called once the initial scan is done: stop telling its visitor
+    /// and remove the watches of the directories which weren't read.
+    void scanned();
+    /// Wait timeout ms for events, then apply them; returns whether there
+    /// were some.
+    bool update(int timeout);
+
+    /// directories watched
+    size_t watched() const;
+    /// directories which couldn't be watched, usually because of the limit
+    /// on the number of watches
+    size_t unwatched() const;
+    /// directories read again because of an event
+    size_t refreshed() const;
+    /// subtrees scanned again because of a queue overflow
+    size_t rescanned() const;
+
+    virtual void enter(DirTree const& tree, DirTree::Index node, std::string const& path);
+    virtual void read(size_t entries, size_t size);
+    virtual void finalized(DirTree const& tree, DirTree::Index node);
+    virtual void error(std::string const& message);
+private: // and not implemented
+    Watcher(Watcher const&);
+    Watcher& operator=(Watcher const&);
+
+private:
+    struct Group;
+
+    size_t groupOf(DirTree::Index node);
+    size_t newGroup();
+    void watch(size_t group, DirTree const& tree, DirTree::Index node,
+               std::string const& path);
+    void unwatch(DirTree::Index node);
+    void readEvents(size_t group);
+    void refresh(DirTree::Index node);
+    void rescan(DirTree::Index node);
+    void addSubtree(DirTree::Index parent, std::string const& name);
+    void removeSubtree(DirTree::Index node);
+    DirTree::Index copy(DirTree const& from, DirTree::Index node, DirTree::Index parent,
+                        DirTree::Index previous, char const* name,
+                        std::vector<DirTree::Index>& copies);
+    void propagate(DirTree::Index node, long long size, long long otherSize,
+                   long long files);
+    DirTree::Index lastChild(DirTree::Index node) const;
+    size_t sizeOf(FileInfo const& info) const;
+    size_t otherSizeOf(FileInfo const& info) const;
+
+    DirTree* myTree;
+    ScanOptions myOptions; // for the rescans, with this as visitor
+    ScanVisitor* myNext; // visitor of the initial scan, NULL once done
+    std::mutex myMutex; // the watches are set by the scanning threads
+    std::vector<Group*> myGroups; // the first one is shared
+    std::vector<size_t> myFreeGroups; // whose subtree has been removed
+    std::unordered_map<DirTree::Index, size_t> myGroupOfKeys; // for the subdirectories of the roots
+    std::unordered_map<DirTree::Index, std::pair<size_t, int> > myWatches; // (group, watch descriptor)
+    size_t myPendingGroup; // of the subtree being scanned
+    std::vector<std::pair<DirTree::Index, int> > myPending; // its watches, by node of its own tree
+    std::set<std::pair<size_t, int> > myChanged; // (group, watch descriptor)
+    size_t myUnwatched;
+    size_t myRefreshed;
+    size_t myRescanned;
+    std::vector<char> myBuffer; // for DirReader
+}; // Watcher
+
+// ----------------------------------------------------------------------------
+
+#endif
@@ -44,20 +44,35 @@
 #include <errno.h>
 #include <errno.h>
 #include <exception>
+#include <fstream>
+#include <getopt.h>
 #include <iostream>
+#include <memory>
 #include <set>
 #include <stdexcept>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/stat.h>
+#include <sys/sysmacros.h>
 #include <sys/types.h>
+#include <thread>
+#include <time.h>
 #include <unistd.h>
 #include <vector>
-#include <iomanip>
 #include <iterator>
 
 #include "info.hpp"
+#include "DirDiff.hpp"
 #include "DirInfo.hpp"
+#include "IgnoreMatcher.hpp"
+#include "InodeSet.hpp"
+#include "IoScheduler.hpp"
+#include "Progress.hpp"
+#include "RecordWriter.hpp"
+#include "Scanner.hpp"
+#include "Snapshot.hpp"
+#include "Stats.hpp"
+#include "Watcher.hpp"
 
 // ----------------------------------------------------------------------------
 
@@ -67,6 +82,30 @@ bool useReadableNumbers = false;
 size_t minimumSize = 0;
 size_t minimumPercent = 0;
 size_t minimumDepth = 0;
+size_t topCount = 0; // 0 to show all directories
+bool showStats = false;
+size_t jobs = 1;
+bool jobsGiven = false;
+bool adaptiveIo = false;
+size_t const adaptiveJobs = 64; // threads by default with adaptiveIo
+bool useIoUring = false;
+bool countLinksOnce = false;
+bool oneFileSystem = false;
+bool foldSmall = false; // below minimumSize, while scanning
+bool showHistograms = false;
+size_t const shownExtensions = 20;
+bool showDevices = false;
+size_t watchPeriod = 0; // seconds between the reports of --watch, 0 for none
+bool writeRecords = false; // instead of the views
+RecordWriter::Format recordFormat = RecordWriter::jsonLines;
+size_t const maxInodes = size_t(1) << 26;
+std::string cacheFile;
+std::string saveFile;
+std::string loadFile;
+std::string baseFile;
+DirTree const* baseTree = NULL;
+std::set<std::string> ignoredDirectories; // the patterns, for the settings
+IgnoreMatcher ignoredMatcher;
 
 // ----------------------------------------------------------------------------
 
@@ -83,7 +122,7 @@ public:
 /// Display simple usage information
 void usage()
 {
-    std::cout << "Usage: dirsize [-hstblr] [-i dir] [-m minSize] [-p minPercent] [-d depth] dirs...\n";
+    std::cout << "Usage: dirsize [-hstblruxH] [-c cache] [-o snapshot | -f snapshot] [-D snapshot] [--top count] [-i dir] [--exclude-from file] [--stats] [--devices] [--format json|csv|nul] [--columns list] [--histograms] [--fold] [--watch seconds] [--adaptive] [-m minSize] [-p minPercent] [-d depth] [-j jobs] dirs...\n";
 } // usage
 
 // ----------------------------------------------------------------------------
@@ -97,14 +136,44 @@ void help()
         "\n"
         "-h          this help\n"
         "-i dir      ignore dir, may be specified several times\n"
+        "--exclude-from file\n"
+        "            ignore the dirs listed in file, one per line\n"
         "-m minSize  show only directories whose size is above minSize\n"
         "-p percent  show only directories whose size if more than percent percent of total size\n"
         "-d depth    show at least all directories until depth\n"
+        "--top count show only the count biggest directories in the flat view\n"
+        "--fold      fold the directories below minSize into their parent's content\n"
+        "            as soon as they are scanned, keeping only the shown ones in memory\n"
+        "-j jobs     scan with jobs threads (0 for one per processor)\n"
+        "-H          count only once files with several hard links\n"
+        "-x          stay on the file system of each dir, don't cross mount points\n"
+        "--devices   show the total size on each device\n"
+        "--histograms\n"
+        "            show the distribution of the files by size, type and age, and\n"
+        "            the biggest extensions\n"
+        "--format fmt\n"
+        "            write a record per directory in fmt (json, csv or nul) as soon\n"
+        "            as it is scanned, instead of the views\n"
+        "-c cache    reuse the unchanged directories of cache and update it\n"
+        "-o snapshot save the scanned trees in snapshot\n"
+        "-f snapshot show the trees saved in snapshot instead of scanning\n"
+        "-D snapshot show the size changes since snapshot\n"
+        "--watch seconds\n"
+        "            keep watching the trees after the scan and show them again every\n"
+        "            seconds seconds when they have changed\n"
+        "-u          examine the entries of a directory in one batch with io_uring\n"
+        "--adaptive  limit the directories read at the same time on each file system\n"
+        "            according to its kind and latency (with 64 threads unless -j)\n"
         "-t          show a directory tree\n"
         "-b          show both a tree and a flat view\n"
         "-l          show logical size (instead of physical one)\n"
+        "--columns list\n"
+        "            show these columns before the names: size (the default), logical,\n"
+        "            physical, ratio (logical/physical), files, and the size class,\n"
+        "            type and age with the most bytes (sizes, types and ages)\n"
         "-r          show readable size (with SI units)\n"
-        "-s          silent, don't show progress\n";
+        "-s          silent, don't show progress\n"
+        "--stats     write statistics about the run in JSON on the standard error\n";
 } // help
 
 // ----------------------------------------------------------------------------
@@ -153,18 +222,19 @@ size_t evalString(std::string const& s, bool suffixes, bool binarySuffixes)
 // FlatDirDisplayer
 // ----------------------------------------------------------------------------
 
-class FlatDirDisplayer: public std::iterator<std::output_iterator_tag, DirInfo*>
+class FlatDirDisplayer: public std::iterator<std::output_iterator_tag, DirInfo>
 {
 public:
     FlatDirDisplayer(std::ostream& os);
 
-    FlatDirDisplayer& operator=(DirInfo* info);
+    FlatDirDisplayer& operator=(DirInfo const& info);
     FlatDirDisplayer& operator++() { return *this; }
     FlatDirDisplayer& operator++(int) { return *this; }
     FlatDirDisplayer& operator*() { return *this; }
 private:
 
     std::ostream* myOS;
+    std::string myLine; // reused, the paths are appended to it
 }; // FlatDirDisplayer
 
 // ----------------------------------------------------------------------------
@@ -176,40 +246,624 @@ FlatDirDisplayer::FlatDirDisplayer(std::ostream& os)
 
 // ----------------------------------------------------------------------------
 
-FlatDirDisplayer& FlatDirDisplayer::operator=(DirInfo* info)
+FlatDirDisplayer& FlatDirDisplayer::operator=(DirInfo const& info)
 {
-    *myOS << std::setw(15) << format(info->size()) << " " << info->path() << '\n';
+    myLine.clear();
+    info.appendColumns(myLine);
+    myLine += ' ';
+    info.appendPath(myLine);
+    myLine += '\n';
+    myOS->write(myLine.data(), std::streamsize(myLine.size()));
     return *this;
 } // operator=
 
 // ----------------------------------------------------------------------------
 
-bool isSmaller(DirInfo* l, DirInfo* r)
+bool isSmaller(DirInfo const& l, DirInfo const& r)
 {
-    return l->size() < r->size();
+    return l.size() < r.size();
 } // isSmaller
 
 // ----------------------------------------------------------------------------
 
-void handleDirectory(std::string const& dir)
+/// Set the columns of the views from a comma separated list of names
+bool setColumns(std::string const& list)
 {
-    DirInfo topInfo(dir, dir, NULL);
-    size_t minSize = minimumSize;
+    std::vector<DirInfo::Column> columns;
+    size_t start = 0;
+    for (;;) {
+        size_t const end = std::min(list.find(',', start), list.size());
+        std::string const name = list.substr(start, end - start);
+        if (name == "size") {
+            columns.push_back(DirInfo::sizeColumn);
+        } else if (name == "logical") {
+            columns.push_back(DirInfo::logicalColumn);
+        } else if (name == "physical") {
+            columns.push_back(DirInfo::physicalColumn);
+        } else if (name == "ratio") {
+            columns.push_back(DirInfo::ratioColumn);
+        } else if (name == "files") {
+            columns.push_back(DirInfo::filesColumn);
+        } else if (name == "sizes") {
+            columns.push_back(DirInfo::sizesColumn);
+        } else if (name == "types") {
+            columns.push_back(DirInfo::typesColumn);
+        } else if (name == "ages") {
+            columns.push_back(DirInfo::agesColumn);
+        } else {
+            std::cerr << "Unknown column " << name << '\n';
+            return false;
+        }
+        if (end == list.size())
+            break;
+        start = end + 1;
+    }
+    DirInfo::setColumns(columns);
+    return true;
+} // setColumns
+
+// ----------------------------------------------------------------------------
+
+/// Ignore the directories matching pattern
+void addIgnored(std::string const& pattern)
+{
+    ignoredMatcher.add(pattern);
+    ignoredDirectories.insert(pattern);
+} // addIgnored
+
+// ----------------------------------------------------------------------------
+
+/// Ignore the directories matching the patterns of file, one per line;
+/// empty lines and those starting with # are skipped.
+bool addIgnoredFrom(std::string const& file)
+{
+    std::ifstream is(file.c_str());
+    if (!is) {
+        error("Unable to open " + file);
+        return false;
+    }
+    std::string line;
+    while (std::getline(is, line)) {
+        if (!line.empty() && line[line.size() - 1] == '\r')
+            line.erase(line.size() - 1);
+        if (!line.empty() && line[0] != '#')
+            addIgnored(line);
+    }
+    return true;
+} // addIgnoredFrom
+
+// ----------------------------------------------------------------------------
+
+/// The options influencing the content of the tree, a cache built with other
+/// ones can't be used.
+std::string scanSettings()
+{
+    std::string result = useLogicalSize() ? "logical\n" : "physical\n";
+    if (countLinksOnce)
+        result += "links once\n";
+    if (oneFileSystem)
+        result += "one file system\n";
+    if (foldSmall)
+        result += "folded below " + std::to_string(minimumSize) + " until depth "
+            + std::to_string(minimumDepth) + '\n';
+    for (std::set<std::string>::const_iterator i = ignoredDirectories.begin(),
+             e = ignoredDirectories.end();
+         i != e; ++i)
+    {
+        result += "ignore " + *i + '\n';
+    }
+    return result;
+} // scanSettings
+
+// ----------------------------------------------------------------------------
+
+void showReports(DirTree const& tree, DirTree::Index root);
+
+// ----------------------------------------------------------------------------
+
+/// The root of tree named name, none if there is none
+DirTree::Index findRoot(DirTree const& tree, std::string const& name)
+{
+    DirTree::Index i = tree.firstRoot();
+    while (i != DirTree::none && name != tree.name(i)) {
+        i = tree.nextSibling(i);
+    }
+    return i;
+} // findRoot
+
+// ----------------------------------------------------------------------------
+
+/// Check that the sizes of baseTree, if any, are comparable with the current
+/// ones.
+bool isBaseComparable()
+{
+    if (baseTree != NULL && baseTree->isLogical() != useLogicalSize()) {
+        std::cerr << "Snapshot " << baseFile << " records "
+                  << (baseTree->isLogical() ? "logical" : "physical")
+                  << " sizes, it can't be compared\n";
+        return false;
+    }
+    return true;
+} // isBaseComparable
+
+// ----------------------------------------------------------------------------
+
+/// Show the size of each of the trees and their total
+void showCombined(std::vector<DirInfo> const& roots)
+{
+    std::string line;
+    size_t total = 0;
+    for (size_t i = 0; i < roots.size(); ++i) {
+        line.clear();
+        appendFormat(line, roots[i].size());
+        alignRight(line, 0, 15);
+        line += ' ';
+        roots[i].appendName(line);
+        line += '\n';
+        std::cout.write(line.data(), std::streamsize(line.size()));
+        total += roots[i].size();
+    }
+    line.clear();
+    appendFormat(line, total);
+    alignRight(line, 0, 15);
+    line += " total for ";
+    appendNumber(line, roots.size());
+    line += " trees\n";
+    std::cout.write(line.data(), std::streamsize(line.size()));
+} // showCombined
+
+// ----------------------------------------------------------------------------
+
+/// Whether the scan keeps the histograms
+bool keepHistograms()
+{
+    return showHistograms || DirInfo::needsHistograms();
+} // keepHistograms
+
+// ----------------------------------------------------------------------------
+
+/// Append a line of a distribution: size, files, share of total and name
+void appendShare(std::string& line, uint64_t size, uint64_t files, uint64_t total,
+                 std::string const& name, bool logical)
+{
+    size_t const start = line.size();
+    appendFormat(line, displaySize(size, logical));
+    alignRight(line, start, 15);
+    line += ' ';
+    size_t const filesStart = line.size();
+    appendNumber(line, files);
+    alignRight(line, filesStart, 12);
+    line += ' ';
+    size_t const shareStart = line.size();
+    line += std::to_string(total == 0 ? 0 : size * 100 / total);
+    line += '%';
+    alignRight(line, shareStart, 4);
+    line += ' ';
+    line += name;
+    line += '\n';
+} // appendShare
+
+// ----------------------------------------------------------------------------
+
+/// Show the distributions of the files of the tree rooted at root, logical
+/// telling the unit of its sizes
+void showRootHistograms(DirInfo const& root, bool logical)
+{
+    Histogram const* histogram = root.histogram();
+    if (histogram == NULL)
+        return;
+    Histogram::Kind const kinds[] = { Histogram::bySize, Histogram::byType, Histogram::byAge };
+    char const* const titles[] = { " by size:\n", " by type:\n", " by age:\n" };
+    std::string line;
+    for (size_t k = 0; k < sizeof kinds / sizeof kinds[0]; ++k) {
+        Histogram::Kind const kind = kinds[k];
+        uint64_t total = 0;
+        for (size_t c = 0; c < Histogram::classCount(kind); ++c) {
+            total += histogram->size(kind, c);
+        }
+        line = "Files of ";
+        root.appendPath(line);
+        line += titles[k];
+        for (size_t c = 0; c < Histogram::classCount(kind); ++c) {
+            if (histogram->files(kind, c) != 0)
+                appendShare(line, histogram->size(kind, c), histogram->files(kind, c),
+                            total, Histogram::className(kind, c), logical);
+        }
+        std::cout.write(line.data(), std::streamsize(line.size()));
+    }
+} // showRootHistograms
+
+// ----------------------------------------------------------------------------
+
+bool extensionIsBigger(std::pair<std::string, std::pair<uint64_t, uint64_t> > const& l,
+                       std::pair<std::string, std::pair<uint64_t, uint64_t> > const& r)
+{
+    return l.second.second > r.second.second;
+} // extensionIsBigger
+
+// ----------------------------------------------------------------------------
+
+/// Show the extensions with the most bytes, logical telling the unit of
+/// their sizes
+void showExtensions(Histogram::Extensions const& extensions, bool logical)
+{
+    std::vector<std::pair<std::string, std::pair<uint64_t, uint64_t> > > sorted(
+        extensions.begin(), extensions.end());
+    std::sort(sorted.begin(), sorted.end(), extensionIsBigger);
+    uint64_t total = 0;
+    for (size_t i = 0; i < sorted.size(); ++i) {
+        total += sorted[i].second.second;
+    }
+    std::string line = "Files by extension:\n";
+    for (size_t i = 0; i < sorted.size() && i < shownExtensions; ++i) {
+        appendShare(line, sorted[i].second.second, sorted[i].second.first, total,
+                    sorted[i].first.empty() ? "(none)" : "." + sorted[i].first, logical);
+    }
+    std::cout.write(line.data(), std::streamsize(line.size()));
+} // showExtensions
+
+// ----------------------------------------------------------------------------
+
+/// Keep the trees of roots up to date and show them again every watchPeriod
+/// seconds when they have changed; never returns.
+void watchTrees(Watcher& watcher, DirTree const& tree, std::vector<DirInfo> const& roots)
+{
+    for (;;) {
+        if (!watcher.update(int(watchPeriod * 1000)))
+            continue;
+        if (!isSilent()) {
+            time_t const current = time(NULL);
+            char stamp[32];
+            strftime(stamp, sizeof stamp, "%H:%M:%S", localtime(&current));
+            std::cout << "\nChanges at " << stamp << " (" << watcher.refreshed()
+                      << " directories read again, " << watcher.rescanned()
+                      << " subtrees scanned again)\n";
+        }
+        for (size_t i = 0; i < roots.size(); ++i) {
+            showReports(tree, roots[i].index());
+        }
+        if (roots.size() > 1)
+            showCombined(roots);
+        std::cout << std::flush;
+    }
+} // watchTrees
+
+// ----------------------------------------------------------------------------
+
+/// Scan the trees rooted at dirs together and show them
+void handleDirectories(DirTree& tree, DirTree const* cache, std::vector<std::string> const& dirs)
+{
+    InodeSet inodes(maxInodes);
+    ScanOptions options;
+    options.threads = jobs;
+    options.logicalSize = useLogicalSize();
+    options.useIoUring = useIoUring;
+    options.adaptive = adaptiveIo;
+    options.oneFileSystem = oneFileSystem;
+    options.ignored = &ignoredMatcher;
+    options.inodes = countLinksOnce ? &inodes : NULL;
+    options.cache = cache;
+    if (foldSmall) {
+        // folded if it wouldn't be shown, whatever the unit
+        options.foldBelow = useLogicalSize() ? minimumSize : (minimumSize + 511) / 512;
+        options.foldDepth = minimumDepth;
+    }
+    // records are written as the directories are finalized; with them the
+    // progress isn't shown (--format implies -s)
+    std::unique_ptr<ScanVisitor> visitor;
+    if (writeRecords) {
+        visitor.reset(new RecordWriter(std::cout, recordFormat, minimumSize, minimumDepth,
+                                       keepHistograms()));
+    } else if (!isSilent()) {
+        visitor.reset(new Progress(tree));
+    }
+    options.visitor = visitor.get();
+    // the watcher forwards to the visitor; it has to see the directories
+    // before they are read
+    std::unique_ptr<Watcher> watcher;
+    if (watchPeriod != 0) {
+        watcher.reset(new Watcher(tree, options));
+        if (!watcher->ok()) {
+            error("Unable to watch the directories");
+            throw EXIT_FAILURE;
+        }
+        options.visitor = watcher.get();
+    }
+    if (keepHistograms())
+        tree.keepHistograms();
+    Scanner scanner(options);
+    size_t const firstNode = tree.nodeCount();
+    std::vector<DirInfo> roots;
+    {
+        PhaseTimer timer(scanPhase);
+        roots = scanner.scan(tree, dirs);
+    }
+    if (watcher)
+        watcher->scanned();
+    // stop the progress, flush the records
+    visitor.reset();
     if (!isSilent())
-        std::cout << "Reading directory structure done\n";
+        std::cout << "Reading directory structure done ("
+                  << tree.nodeCount() - tree.freeCount() - firstNode << " nodes, "
+                  << tree.memoryUsed() / tree.nodeCount() << " bytes per node; "
+                  << scanner.statsAvoided() << " stat calls avoided, "
+                  << scanner.untypedEntries() << " entries without type)\n";
+    if (!isSilent() && cache != NULL)
+        std::cout << "Cache: " << scanner.cacheHits() << " directories reused, "
+                  << scanner.cacheMisses() << " read again\n";
+    IoScheduler const* scheduler = scanner.scheduler();
+    if (!isSilent() && scheduler != NULL) {
+        std::cout << "Adaptive I/O: " << scheduler->networkDevices() << " network file systems";
+        if (scheduler->networkDevices() != 0)
+            std::cout << " (" << scheduler->lowestLimit() << " to "
+                      << scheduler->highestLimit() << " directories at a time)";
+        std::cout << ", " << scheduler->waits() << " waits\n";
+    }
+    if (!isSilent() && oneFileSystem)
+        std::cout << "Mount points: " << scanner.mountPoints() << " not crossed\n";
+    if (!isSilent() && foldSmall)
+        std::cout << "Folded: " << scanner.folded() << " directories, "
+                  << tree.nodeCount() << " nodes at most\n";
+    if (!isSilent() && countLinksOnce) {
+        std::cout << "Hard links: " << inodes.count() << " inodes recorded in "
+                  << inodes.memoryUsed() << " bytes, "
+                  << scanner.linksSkipped() << " links not counted again";
+        if (inodes.dropped() != 0)
+            std::cout << ", " << inodes.dropped() << " inodes not recorded (table full)";
+        std::cout << '\n';
+    }
+    if (!isSilent() && watcher) {
+        std::cout << "Watching: " << watcher->watched() << " directories";
+        if (watcher->unwatched() != 0)
+            std::cout << ", " << watcher->unwatched()
+                      << " not watched (see fs.inotify.max_user_watches)";
+        std::cout << '\n';
+    }
+    if (writeRecords)
+        return;
+    for (size_t i = 0; i < roots.size(); ++i) {
+        showReports(tree, roots[i].index());
+    }
+    if (roots.size() > 1)
+        showCombined(roots);
+    if (showHistograms) {
+        for (size_t i = 0; i < roots.size(); ++i) {
+            showRootHistograms(roots[i], tree.isLogical());
+        }
+        Histogram::Extensions extensions;
+        scanner.addExtensions(extensions);
+        showExtensions(extensions, tree.isLogical());
+    }
+    if (watcher) {
+        // watchTrees never returns: the statistics are those of the scan
+        if (showStats)
+            writeStats(std::cerr, tree.nodeCount(), tree.memoryUsed(), jobs);
+        watchTrees(*watcher, tree, roots);
+    }
+} // handleDirectories
+
+// ----------------------------------------------------------------------------
+
+/// Whether snapshot records logical sizes
+bool isLogical(Snapshot const& snapshot)
+{
+    return snapshot.settings().compare(0, 8, "logical\n") == 0;
+} // isLogical
+
+// ----------------------------------------------------------------------------
+
+/// Show the trees saved in loadFile (those of dirs if not empty) and
+/// return the exit status.
+int showSnapshot(std::vector<std::string> const& dirs)
+{
+    Snapshot snapshot;
+    DirTree tree;
+    if (!snapshot.load(loadFile, tree)) {
+        error("Unable to load snapshot " + loadFile);
+        return EXIT_FAILURE;
+    }
+    // the sizes have been recorded as the scan was told to
+    tree.setLogical(isLogical(snapshot));
+    setLogicalSize(tree.isLogical());
+    if (!isBaseComparable())
+        return EXIT_FAILURE;
+    if (!isSilent())
+        std::cout << "Snapshot " << loadFile << " loaded ("
+                  << tree.nodeCount() << " nodes, "
+                  << snapshot.fileSize() << " bytes)\n";
+    int status = EXIT_SUCCESS;
+    std::vector<DirInfo> roots;
+    for (size_t d = 0; d < dirs.size(); ++d) {
+        DirTree::Index i = findRoot(tree, dirs[d]);
+        if (i == DirTree::none) {
+            std::cerr << dirs[d] << " is not in snapshot " << loadFile << '\n';
+            status = EXIT_FAILURE;
+        } else {
+            roots.push_back(DirInfo(&tree, i));
+        }
+    }
+    if (dirs.empty()) {
+        for (DirTree::Index i = tree.firstRoot(); i != DirTree::none; i = tree.nextSibling(i)) {
+            roots.push_back(DirInfo(&tree, i));
+        }
+    }
+    if (writeRecords) {
+        RecordWriter records(std::cout, recordFormat, minimumSize, minimumDepth, false);
+        for (size_t i = 0; i < roots.size(); ++i) {
+            records.writeTree(tree, roots[i].index());
+        }
+    } else {
+        for (size_t i = 0; i < roots.size(); ++i) {
+            showReports(tree, roots[i].index());
+        }
+        if (roots.size() > 1)
+            showCombined(roots);
+    }
+    if (showStats)
+        writeStats(std::cerr, tree.nodeCount(), tree.memoryUsed(), 0);
+    return status;
+} // showSnapshot
+
+// ----------------------------------------------------------------------------
+
+class DeltaIsSmaller
+{
+public:
+    explicit DeltaIsSmaller(DirDiff const& diff) : myDiff(&diff) {}
+    bool operator()(DirDiff::Index l, DirDiff::Index r) const
+    {
+        return llabs(myDiff->delta(l)) < llabs(myDiff->delta(r));
+    }
+private:
+    DirDiff const* myDiff;
+}; // DeltaIsSmaller
+
+// ----------------------------------------------------------------------------
+
+/// Show the changes between the tree of baseTree named as root and root;
+/// the thresholds apply to the absolute value of the change.
+void showDelta(DirTree const& tree, DirTree::Index root)
+{
+    DirDiff diff(*baseTree, tree);
+    DirDiff::Index top;
+    {
+        PhaseTimer timer(collectPhase);
+        top = diff.compare(findRoot(*baseTree, tree.name(root)), root);
+    }
+    size_t const total = size_t(llabs(diff.delta(top)));
+    size_t minDelta = minimumSize;
+    if (total * minimumPercent / 100 > minDelta)
+        minDelta = total * minimumPercent / 100;
+    if (showHierInfo) {
+        PhaseTimer timer(outputPhase);
+        diff.showTree(std::cout, top, minDelta, minimumDepth);
+    }
+    if (showFlatInfo) {
+        std::vector<DirDiff::Index> flatDirs;
+        {
+            PhaseTimer timer(collectPhase);
+            flatDirs.push_back(top);
+            diff.collect(top, minDelta, flatDirs, minimumDepth);
+            if (topCount != 0 && topCount < flatDirs.size()) {
+                // the change of a directory doesn't bound those of its
+                // subdirectories, all have to be considered
+                std::nth_element(flatDirs.begin(), flatDirs.end() - ptrdiff_t(topCount),
+                                 flatDirs.end(), DeltaIsSmaller(diff));
+                flatDirs.erase(flatDirs.begin(), flatDirs.end() - ptrdiff_t(topCount));
+            }
+            std::sort(flatDirs.begin(), flatDirs.end(), DeltaIsSmaller(diff));
+        }
+        PhaseTimer timer(outputPhase);
+        std::string line;
+        for (size_t i = 0; i < flatDirs.size(); ++i) {
+            line.clear();
+            appendDelta(line, diff.delta(flatDirs[i]));
+            alignRight(line, 0, 15);
+            line += ' ';
+            diff.appendPath(line, flatDirs[i]);
+            line += '\n';
+            std::cout.write(line.data(), std::streamsize(line.size()));
+        }
+    }
+} // showDelta
+
+// ----------------------------------------------------------------------------
+
+/// Size of the directories on a device
+struct DeviceTotal
+{
+    uint64_t device;
+    size_t size;
+    DirTree::Index top; // the first directory met on the device
+}; // DeviceTotal
+
+// ----------------------------------------------------------------------------
+
+bool totalIsSmaller(DeviceTotal const& l, DeviceTotal const& r)
+{
+    return l.size < r.size;
+} // totalIsSmaller
+
+// ----------------------------------------------------------------------------
+
+/// Show the size of the tree rooted at root on each device; the content of a
+/// directory is counted on its device.
+void showDeviceTotals(DirTree const& tree, DirTree::Index root)
+{
+    std::vector<DeviceTotal> totals; // only a few devices are expected
+    std::vector<DirTree::Index> pending(1, root);
+    while (!pending.empty()) {
+        DirTree::Index const i = pending.back();
+        pending.pop_back();
+        if (tree.isContent(i))
+            continue;
+        size_t t = 0;
+        while (t < totals.size() && totals[t].device != tree.device(i)) {
+            ++t;
+        }
+        if (t == totals.size()) {
+            DeviceTotal const total = { tree.device(i), 0, i };
+            totals.push_back(total);
+        }
+        totals[t].size += displaySize(tree.directSize(i), tree.isLogical());
+        for (DirTree::Index c = tree.firstChild(i); c != DirTree::none; c = tree.nextSibling(c)) {
+            pending.push_back(c);
+        }
+    }
+    std::sort(totals.begin(), totals.end(), totalIsSmaller);
+    std::string line;
+    for (size_t t = 0; t < totals.size(); ++t) {
+        line.clear();
+        appendFormat(line, totals[t].size);
+        alignRight(line, 0, 15);
+        line += " device ";
+        line += std::to_string(major(totals[t].device));
+        line += ':';
+        line += std::to_string(minor(totals[t].device));
+        line += ", from ";
+        DirInfo(&tree, totals[t].top).appendPath(line);
+        line += '\n';
+        std::cout.write(line.data(), std::streamsize(line.size()));
+    }
+} // showDeviceTotals
+
+// ----------------------------------------------------------------------------
+
+void showReports(DirTree const& tree, DirTree::Index root)
+{
+    if (baseTree != NULL) {
+        showDelta(tree, root);
+        if (showDevices)
+            showDeviceTotals(tree, root);
+        return;
+    }
+    DirInfo topInfo(&tree, root);
+    size_t minSize = minimumSize;
     if (topInfo.size() * minimumPercent / 100 > minSize)
         minSize = topInfo.size() * minimumPercent / 100;
     if (showHierInfo) {
+        PhaseTimer timer(outputPhase);
         topInfo.showTree(std::cout, minSize, minimumDepth);
     }
     if (showFlatInfo) {
-        std::deque<DirInfo*> flatDirs;
-        flatDirs.push_back(&topInfo);
-        topInfo.collect(minSize, flatDirs, minimumDepth);
-        std::sort(flatDirs.begin(), flatDirs.end(), isSmaller);
+        std::vector<DirInfo> flatDirs;
+        {
+            PhaseTimer timer(collectPhase);
+            if (topCount != 0) {
+                DirInfo::keepBiggest(topInfo, topCount, flatDirs);
+                topInfo.collectBiggest(minSize, topCount, flatDirs, minimumDepth);
+            } else {
+                flatDirs.push_back(topInfo);
+                topInfo.collect(minSize, flatDirs, minimumDepth);
+            }
+            std::sort(flatDirs.begin(), flatDirs.end(), isSmaller);
+        }
+        PhaseTimer timer(outputPhase);
         std::copy(flatDirs.begin(), flatDirs.end(), FlatDirDisplayer(std::cout));
     }
-} // handleDirectory
+    if (showDevices)
+        showDeviceTotals(tree, root);
+} // showReports
 
 // ----------------------------------------------------------------------------
 
@@ -223,7 +877,26 @@ int main(int argc, char* argv[])
         std::locale::global(std::locale(""));
         std::cout.imbue(std::locale());
 
-        while (c = getopt(argc, argv, "hstblri:m:p:d:"), c != -1) {
+        enum { topOption = 256, excludeFromOption, statsOption, devicesOption,
+               formatOption, columnsOption, foldOption, histogramsOption, watchOption,
+               adaptiveOption };
+        static struct option const longOptions[] = {
+            { "help", no_argument, NULL, 'h' },
+            { "top", required_argument, NULL, topOption },
+            { "exclude-from", required_argument, NULL, excludeFromOption },
+            { "stats", no_argument, NULL, statsOption },
+            { "devices", no_argument, NULL, devicesOption },
+            { "format", required_argument, NULL, formatOption },
+            { "columns", required_argument, NULL, columnsOption },
+            { "fold", no_argument, NULL, foldOption },
+            { "histograms", no_argument, NULL, histogramsOption },
+            { "watch", required_argument, NULL, watchOption },
+            { "adaptive", no_argument, NULL, adaptiveOption },
+            { NULL, 0, NULL, 0 }
+        };
+        while (c = getopt_long(argc, argv, "hstblruxHc:o:f:D:i:m:p:d:j:", longOptions, NULL),
+               c != -1)
+        {
             switch (c) {
             case 'h':
                 help();
@@ -243,7 +916,27 @@ int main(int argc, char* argv[])
                 setUseReadableNumbers(true);
                 break;
             case 'i':
-                DirInfo::addIgnoredDirectory(optarg);
+                addIgnored(optarg);
+                break;
+            case statsOption:
+                showStats = true;
+                setTimePhases(true);
+                break;
+            case excludeFromOption:
+                if (!addIgnoredFrom(optarg))
+                    errcnt++;
+                break;
+            case 'c':
+                cacheFile = optarg;
+                break;
+            case 'o':
+                saveFile = optarg;
+                break;
+            case 'f':
+                loadFile = optarg;
+                break;
+            case 'D':
+                baseFile = optarg;
                 break;
             case 'm':
                 minimumSize = evalString(optarg, true /* accept suffixes */, true /* binary suffixes */);
@@ -258,6 +951,57 @@ int main(int argc, char* argv[])
             case 'd':
                 minimumDepth = evalString(optarg, false, false);
                 break;
+            case 'j':
+                jobs = evalString(optarg, false, false);
+                if (jobs == 0)
+                    jobs = std::thread::hardware_concurrency();
+                jobsGiven = true;
+                break;
+            case topOption:
+                topCount = evalString(optarg, false, false);
+                break;
+            case 'u':
+                useIoUring = true;
+                break;
+            case 'H':
+                countLinksOnce = true;
+                break;
+            case 'x':
+                oneFileSystem = true;
+                break;
+            case devicesOption:
+                showDevices = true;
+                break;
+            case foldOption:
+                foldSmall = true;
+                break;
+            case histogramsOption:
+                showHistograms = true;
+                break;
+            case adaptiveOption:
+                adaptiveIo = true;
+                break;
+            case watchOption:
+                watchPeriod = evalString(optarg, false, false);
+                if (watchPeriod == 0 || watchPeriod > 86400) {
+                    std::cerr << "The period of --watch should be between 1 and 86400 seconds\n";
+                    errcnt++;
+                }
+                break;
+            case columnsOption:
+                if (!setColumns(optarg))
+                    errcnt++;
+                break;
+            case formatOption:
+                if (RecordWriter::parseFormat(optarg, recordFormat)) {
+                    writeRecords = true;
+                    // the standard output is for the records
+                    setSilent(true);
+                } else {
+                    std::cerr << "Unknown format " << optarg << '\n';
+                    errcnt++;
+                }
+                break;
             case 'l':
                 setLogicalSize(true);
                 break;
@@ -270,18 +1014,104 @@ int main(int argc, char* argv[])
             }
         }
 
+        if (countLinksOnce && !cacheFile.empty()) {
+            // the sizes depend on the links seen elsewhere
+            std::cerr << "-c can't be used with -H\n";
+            errcnt++;
+        }
+
+        if (!loadFile.empty() && (!cacheFile.empty() || !saveFile.empty())) {
+            std::cerr << "-f can't be used with -c or -o\n";
+            errcnt++;
+        }
+
+        if (foldSmall && (!cacheFile.empty() || !baseFile.empty() || !loadFile.empty())) {
+            // the folded directories are missing from the tree
+            std::cerr << "--fold can't be used with -c, -D or -f\n";
+            errcnt++;
+        }
+
+        if (keepHistograms() && (!cacheFile.empty() || !loadFile.empty())) {
+            // they are neither in the caches nor in the snapshots
+            std::cerr << "--histograms and the sizes, types and ages columns can't be used"
+                         " with -c or -f\n";
+            errcnt++;
+        }
+
+        if (watchPeriod != 0
+            && (!cacheFile.empty() || !saveFile.empty() || !loadFile.empty()
+                || !baseFile.empty() || countLinksOnce || foldSmall || writeRecords
+                || keepHistograms()))
+        {
+            // the events tell nothing of what isn't in the tree, and the
+            // trees are never complete
+            std::cerr << "--watch can't be used with -c, -o, -f, -D, -H, --fold, --format,"
+                         " --histograms or the sizes, types and ages columns\n";
+            errcnt++;
+        }
+
+        if (writeRecords && !baseFile.empty()) {
+            std::cerr << "--format can't be used with -D\n";
+            errcnt++;
+        }
+
         if (errcnt > 0) {
             usage();
             throw EXIT_FAILURE;
         }
 
-        if (optind < argc) {
-            for ( ; optind < argc; ++optind) {
-                handleDirectory(argv[optind]);
+        if (adaptiveIo && !jobsGiven)
+            jobs = adaptiveJobs;
+
+        Snapshot baseSnapshot;
+        DirTree base;
+        if (!baseFile.empty()) {
+            if (!baseSnapshot.load(baseFile, base)) {
+                error("Unable to load snapshot " + baseFile);
+                throw EXIT_FAILURE;
             }
-        } else {
-            handleDirectory(".");
+            base.setLogical(isLogical(baseSnapshot));
+            baseTree = &base;
+        }
+
+        if (!loadFile.empty())
+            return showSnapshot(std::vector<std::string>(argv + optind, argv + argc));
+
+        if (!isBaseComparable())
+            throw EXIT_FAILURE;
+
+        DirTree tree;
+        Snapshot cacheSnapshot;
+        DirTree cacheTree;
+        DirTree const* cache = NULL;
+        if (!cacheFile.empty()) {
+            if (cacheSnapshot.load(cacheFile, cacheTree)) {
+                if (cacheSnapshot.settings() == scanSettings()) {
+                    cache = &cacheTree;
+                } else if (!isSilent()) {
+                    std::cout << "Cache " << cacheFile
+                              << " built with other options, not used\n";
+                }
+            } else if (errno != ENOENT) {
+                error("Unable to load cache " + cacheFile);
+            }
+        }
+
+        std::vector<std::string> dirs(argv + optind, argv + argc);
+        if (dirs.empty())
+            dirs.push_back(".");
+        handleDirectories(tree, cache, dirs);
+
+        if (!cacheFile.empty() && !Snapshot::save(tree, scanSettings(), cacheFile)) {
+            error("Unable to save cache " + cacheFile);
+            status = EXIT_FAILURE;
+        }
+        if (!saveFile.empty() && !Snapshot::save(tree, scanSettings(), saveFile)) {
+            error("Unable to save snapshot " + saveFile);
+            status = EXIT_FAILURE;
         }
+        if (showStats)
+            writeStats(std::cerr, tree.nodeCount(), tree.memoryUsed(), jobs);
     } catch (std::exception& e) {
         std::cerr << "Error: " << e.what() << '\n';
         status = EXIT_FAILURE;
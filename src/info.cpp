@@ -40,9 +40,11 @@
 #include <errno.h>
 #include <iostream>
 #include <iomanip>
+#include <limits.h>
+#include <locale>
+#include <mutex>
 #include <string.h>
-#include <sys/stat.h>
-#include <sstream>
+#include <vector>
 
 namespace
 {
@@ -51,6 +53,33 @@ long long const blockSize = 512;
 bool theSilent = false;
 bool theLogicalSize = false;
 bool theUseReadableNumbers = false;
+
+// scanning threads share the terminal
+std::mutex theOutputMutex;
+
+/// The digit grouping of the global locale, got at the first use
+struct NumberGrouping
+{
+    NumberGrouping()
+    {
+        std::numpunct<char> const& punct
+            = std::use_facet<std::numpunct<char> >(std::locale());
+        std::string const grouping = punct.grouping();
+        for (size_t i = 0; i < grouping.size(); ++i) {
+            sizes.push_back(grouping[i]);
+        }
+        separator = punct.thousands_sep();
+    }
+
+    std::vector<int> sizes;
+    char separator;
+};
+
+NumberGrouping const& numberGrouping()
+{
+    static NumberGrouping const result;
+    return result;
+}
 }
 
 // ----------------------------------------------------------------------------
@@ -69,9 +98,9 @@ bool isSilent()
 
 // ----------------------------------------------------------------------------
 
-size_t displaySize(size_t sz)
+size_t displaySize(size_t sz, bool logical)
 {
-    if (useLogicalSize())
+    if (logical)
         return sz;
     else
         return sz*blockSize;
@@ -79,13 +108,13 @@ size_t displaySize(size_t sz)
 
 // ----------------------------------------------------------------------------
 
-size_t getSize(struct stat& buf)
+size_t otherDisplaySize(size_t sz, bool logical)
 {
-    if (useLogicalSize())
-        return size_t(buf.st_size);
+    if (logical)
+        return sz*blockSize;
     else
-        return size_t(buf.st_blocks);
-} // getSize
+        return sz;
+} // otherDisplaySize
 
 // ----------------------------------------------------------------------------
 
@@ -110,7 +139,33 @@ bool useLogicalSize()
 
 // ----------------------------------------------------------------------------
 
-std::string format(size_t sz)
+void appendNumber(std::string& out, unsigned long long n)
+{
+    NumberGrouping const& grouping = numberGrouping();
+    char digits[64]; // in reverse order, with the separators
+    size_t count = 0;
+    size_t group = 0;
+    int groupSize = grouping.sizes.empty() ? 0 : grouping.sizes[0];
+    int inGroup = 0;
+    do {
+        if (groupSize > 0 && groupSize != CHAR_MAX && inGroup == groupSize) {
+            digits[count++] = grouping.separator;
+            inGroup = 0;
+            if (group + 1 < grouping.sizes.size())
+                groupSize = grouping.sizes[++group];
+        }
+        digits[count++] = char('0' + n % 10);
+        n /= 10;
+        ++inGroup;
+    } while (n != 0);
+    while (count > 0) {
+        out += digits[--count];
+    }
+} // appendNumber
+
+// ----------------------------------------------------------------------------
+
+void appendFormat(std::string& out, size_t sz)
 {
     char const* suffix = "";
     if (theUseReadableNumbers) {
@@ -124,10 +179,50 @@ std::string format(size_t sz)
         sz = (sz + fact/2)/fact;
         suffix = suffixes[suffixIndex];
     }
-    std::ostringstream os;
-    os << sz << ' ' << suffix;
-    return os.str();
-}
+    appendNumber(out, sz);
+    out += ' ';
+    out += suffix;
+} // appendFormat
+
+// ----------------------------------------------------------------------------
+
+std::string format(size_t sz)
+{
+    std::string result;
+    appendFormat(result, sz);
+    return result;
+} // format
+
+// ----------------------------------------------------------------------------
+
+void appendDelta(std::string& out, long long delta)
+{
+    if (delta < 0) {
+        out += '-';
+        appendFormat(out, size_t(-delta));
+    } else {
+        out += '+';
+        appendFormat(out, size_t(delta));
+    }
+} // appendDelta
+
+// ----------------------------------------------------------------------------
+
+std::string formatDelta(long long delta)
+{
+    std::string result;
+    appendDelta(result, delta);
+    return result;
+} // formatDelta
+
+// ----------------------------------------------------------------------------
+
+void alignRight(std::string& out, size_t start, size_t width)
+{
+    size_t const length = out.size() - start;
+    if (length < width)
+        out.insert(start, width - length, ' ');
+} // alignRight
 
 // ----------------------------------------------------------------------------
 
@@ -136,6 +231,7 @@ void message(std::string const& msg)
     if (theSilent)
         return;
     char const* clearToEol = "\033[K";
+    std::lock_guard<std::mutex> lock(theOutputMutex);
     std::cout << msg << clearToEol << '\r' << std::flush;
 } // message
 
@@ -144,6 +240,7 @@ void message(std::string const& msg)
 void error(std::string const& msg)
 {
     std::string info(strerror(errno));
+    std::lock_guard<std::mutex> lock(theOutputMutex);
     std::cerr << '\n' << msg << ": " << info << '\n' << std::flush;
 } // error
 
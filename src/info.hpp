@@ -41,13 +41,28 @@
 #include <string>
 
 bool useLogicalSize();
-size_t displaySize(size_t sz);
-size_t getSize(struct stat&);
+/// sz in bytes, sz being a logical size (in bytes) or a physical one (in
+/// blocks)
+size_t displaySize(size_t sz, bool logical);
+/// like displaySize, for the size of the other kind (physical when logical
+/// is set, and conversely)
+size_t otherDisplaySize(size_t sz, bool logical);
 void setLogicalSize(bool);
 void setSilent(bool);
 void setUseReadableNumbers(bool);
 bool isSilent();
 std::string format(size_t sz);
+/// append format(sz) to out
+void appendFormat(std::string& out, size_t sz);
+/// append n, with the digit grouping of the global locale, to out
+void appendNumber(std::string& out, unsigned long long n);
+/// format with an explicit sign
+std::string formatDelta(long long delta);
+/// append formatDelta(delta) to out
+void appendDelta(std::string& out, long long delta);
+/// pad with spaces the text of out from start so that it is at least width
+/// characters wide
+void alignRight(std::string& out, size_t start, size_t width);
 void message(std::string const&);
 void error(std::string const&);
 